@@ -0,0 +1,88 @@
+#include "async.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <xcb/xcbext.h>
+
+#if __has_include(<X11/Xlib-xcb.h>)
+#include <X11/Xlib-xcb.h>
+#else
+// from libX11-xcb, for systems which ship the library but not its header
+xcb_connection_t *XGetXCBConnection(Display *dpy);
+#endif
+
+xcb_connection_t *xcb;
+
+typedef struct {
+  unsigned int sequence;
+  Window win;
+  ReplyFn fn;
+} Pending;
+
+// outstanding requests in the order they were sent, as a ring
+static Pending* pending = NULL;
+static unsigned int capacity = 0;
+static unsigned int first = 0;
+static unsigned int count = 0;
+
+void async_init(Display *dsp) {
+  xcb = XGetXCBConnection(dsp);
+  assert(xcb);
+  capacity = 64;
+  pending = malloc(sizeof(Pending) * capacity);
+  assert(pending);
+  first = 0;
+  count = 0;
+}
+
+void async_expect(unsigned int sequence, Window win, ReplyFn fn) {
+  if (count == capacity) {
+    // unwrap into storage twice the size
+    Pending* p = malloc(sizeof(Pending) * capacity * 2);
+    assert(p);
+    for (unsigned int i = 0; i < count; i++) {
+      p[i] = pending[(first + i) % capacity];
+    }
+    free(pending);
+    pending = p;
+    capacity *= 2;
+    first = 0;
+  }
+  Pending *p = &pending[(first + count) % capacity];
+  p->sequence = sequence;
+  p->win = win;
+  p->fn = fn;
+  count++;
+}
+
+// run the callback for the oldest request and drop it
+static void finish(void *reply, xcb_generic_error_t *error) {
+  Pending p = pending[first];
+  first = (first + 1) % capacity;
+  count--;
+  // a failed request almost always means the window has gone, which we
+  // hear about through the usual events
+  free(error);
+  p.fn(p.win, reply);
+  free(reply);
+}
+
+unsigned int async_collect() {
+  while (count) {
+    void *reply = NULL;
+    xcb_generic_error_t *error = NULL;
+    if (!xcb_poll_for_reply(xcb, pending[first].sequence, &reply, &error)) {
+      // replies arrive in order, so nothing later is ready either
+      break;
+    }
+    finish(reply, error);
+  }
+  return count;
+}
+
+void async_collect_all() {
+  while (count) {
+    xcb_generic_error_t *error = NULL;
+    void *reply = xcb_wait_for_reply(xcb, pending[first].sequence, &error);
+    finish(reply, error);
+  }
+}
@@ -0,0 +1,32 @@
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include <X11/Xlib.h>
+#include <xcb/xcb.h>
+
+// Deferred collection of XCB replies.
+//
+// Send a request through XCB, hand its cookie's sequence number to
+// async_expect along with a callback, and carry on. async_collect runs the
+// callbacks for whatever replies have arrived, in request order, without
+// ever waiting on the server.
+
+// reply is NULL if the request failed. the callback must free neither.
+typedef void (*ReplyFn)(Window win, void *reply);
+
+// the XCB side of the Xlib connection
+extern xcb_connection_t *xcb;
+
+void async_init(Display *dsp);
+
+// remember that a reply to request sequence is due, concerning win
+void async_expect(unsigned int sequence, Window win, ReplyFn fn);
+
+// run callbacks for every reply which has arrived. returns the number of
+// requests still outstanding.
+unsigned int async_collect();
+
+// wait for every outstanding reply and run its callback
+void async_collect_all();
+
+#endif
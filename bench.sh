@@ -0,0 +1,36 @@
+#!/bin/sh
+
+# Headless end-to-end benchmark. Starts Xvfb, runs wm on it, and drives it
+# with bench_wm at a few window counts. Results are appended to
+# bench_output.txt.
+
+set -eu
+
+display=${BENCH_DISPLAY:-:99}
+counts=${BENCH_COUNTS:-10 100 1000}
+out=${BENCH_OUTPUT:-bench_output.txt}
+
+make wm bench_wm
+
+Xvfb $display -screen 0 1920x1080x24 -nolisten tcp &
+xvfbpid=$!
+trap 'kill $xvfbpid 2>/dev/null' EXIT
+
+sleep 1
+
+export DISPLAY=$display
+
+for n in $counts; do
+    ./wm >> bench_wm.log &
+    wmpid=$!
+    sleep 0.5
+
+    echo "# $(date -u +%FT%TZ) $(git rev-parse --short HEAD 2>/dev/null || echo unknown)" >> $out
+    ./bench_wm $n | tee -a $out
+
+    # dump the wm's own handler stats into bench_wm.log
+    kill -USR1 $wmpid
+    sleep 0.2
+    kill $wmpid
+    wait $wmpid 2>/dev/null || true
+done
@@ -0,0 +1,270 @@
+#include "clients.h"
+#include "windowbuffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Compares clients_find and the focus history against the linear scans
+// and buffer shuffling they replaced, and scans over the split client
+// layout against the single struct it replaced.
+
+#define LOOKUPS 1000000
+
+double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// the old clients_find
+PI linear_find(Window win) {
+  PI p = {
+    .data = NULL,
+    .index = 0,
+  };
+  for (unsigned int i = 0; i < clients.length; i++) {
+    if (*wb_get(&clients_wins, i) == win) {
+      p.data = cb_get(&clients, i);
+      p.index = i;
+    }
+  }
+  return p;
+}
+
+void bench(unsigned int n) {
+  clients_init(n);
+  for (unsigned int i = 0; i < n; i++) {
+    Client c = {0};
+    Rectangle bounds = {0};
+    clients_add(0x400000 + i * 7, bounds, &c);
+  }
+
+  Window* wins = malloc(sizeof(Window) * LOOKUPS);
+  srand(n);
+  for (unsigned int i = 0; i < LOOKUPS; i++) {
+    wins[i] = 0x400000 + (rand() % n) * 7;
+  }
+
+  // scale down the number of linear lookups so big n doesn't take forever
+  unsigned int linear_lookups = LOOKUPS / (n / 10 ? n / 10 : 1);
+  if (linear_lookups < 1000) {
+    linear_lookups = 1000;
+  }
+
+  unsigned long check = 0;
+  double t0 = now_ns();
+  for (unsigned int i = 0; i < linear_lookups; i++) {
+    check += linear_find(wins[i]).index;
+  }
+  double t1 = now_ns();
+  for (unsigned int i = 0; i < LOOKUPS; i++) {
+    check += clients_find(wins[i]).index;
+  }
+  double t2 = now_ns();
+
+  double linear = (t1 - t0) / linear_lookups;
+  double hashed = (t2 - t1) / LOOKUPS;
+  printf("clients_find n=%-6u linear %10.1f ns  hashed %6.1f ns  speedup %8.1fx  (%lu)\n",
+         n, linear, hashed, linear / hashed, check & 1);
+
+  free(wins);
+  clients_free();
+}
+
+// the old clients_focus_raise, over a separate window buffer
+void wb_focus_raise(struct WindowBuffer* history, Window win) {
+  for (unsigned int i = 0; i < history->length; i++) {
+    Window w = *wb_get(history, i);
+    if (win == w) {
+      wb_bring_to_front(history, i);
+      return;
+    }
+  }
+}
+
+void bench_focus(unsigned int n) {
+  struct WindowBuffer history;
+  wb_init(&history, n);
+  clients_init(n);
+  for (unsigned int i = 0; i < n; i++) {
+    Client c = {0};
+    Rectangle bounds = {0};
+    Window win = 0x400000 + i * 7;
+    clients_add(win, bounds, &c);
+    wb_add(&history, &win);
+  }
+
+  // raise random windows, then walk the history as switching does
+  unsigned int raises = LOOKUPS / 10;
+  Window* wins = malloc(sizeof(Window) * raises);
+  srand(n);
+  for (unsigned int i = 0; i < raises; i++) {
+    wins[i] = 0x400000 + (rand() % n) * 7;
+  }
+
+  unsigned int old_raises = raises / (n / 10 ? n / 10 : 1);
+  if (old_raises < 100) {
+    old_raises = 100;
+  }
+
+  double t0 = now_ns();
+  for (unsigned int i = 0; i < old_raises; i++) {
+    wb_focus_raise(&history, wins[i]);
+  }
+  double t1 = now_ns();
+  for (unsigned int i = 0; i < raises; i++) {
+    clients_focus_raise(wins[i]);
+  }
+  double t2 = now_ns();
+
+  unsigned long check = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    check += window_history_get(i);
+  }
+  double t3 = now_ns();
+
+  double old = (t1 - t0) / old_raises;
+  double mru = (t2 - t1) / raises;
+  double walk = (t3 - t2) / n;
+  printf("focus_raise  n=%-6u buffer %10.1f ns  list   %6.1f ns  speedup %8.1fx  history walk %5.1f ns/step  (%lu)\n",
+         n, old, mru, old / mru, walk, check & 1);
+
+  free(wins);
+  clients_free();
+  wb_free(&history);
+}
+
+// the client struct before the window and bounds were split out
+typedef struct {
+  Rectangle current_bounds;
+  Rectangle orig_bounds;
+  Window win;
+  char max_state;
+  char border_width;
+  char* name;
+  unsigned int focus_prev, focus_next;
+  Rectangle sent_bounds;
+  unsigned long sent_border_colour;
+  char sent_border_colour_known;
+  char sent_border_width;
+} WholeClient;
+
+static int contains(Rectangle *r, int x, int y) {
+  return (x >= r->x) & (x < r->x + r->w) & (y >= r->y) & (y < r->y + r->h);
+}
+
+// how many clients are under (x, y). a pass over every client's bounds.
+unsigned int whole_hit(WholeClient *whole, unsigned int n, int x, int y) {
+  unsigned int hits = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    hits += contains(&whole[i].current_bounds, x, y);
+  }
+  return hits;
+}
+
+unsigned int split_hit(int x, int y) {
+  unsigned int hits = 0;
+  Rectangle *bounds = clients_bounds.data;
+  unsigned int n = clients_bounds.length;
+  for (unsigned int i = 0; i < n; i++) {
+    hits += contains(&bounds[i], x, y);
+  }
+  return hits;
+}
+
+unsigned int whole_find(WholeClient *whole, unsigned int n, Window win) {
+  for (unsigned int i = 0; i < n; i++) {
+    if (whole[i].win == win) {
+      return i;
+    }
+  }
+  return n;
+}
+
+unsigned int split_find(Window win) {
+  Window *wins = clients_wins.data;
+  unsigned int n = clients_wins.length;
+  for (unsigned int i = 0; i < n; i++) {
+    if (wins[i] == win) {
+      return i;
+    }
+  }
+  return n;
+}
+
+void bench_layout(unsigned int n) {
+  WholeClient *whole = calloc(n, sizeof(WholeClient));
+  clients_init(n);
+  srand(n);
+  for (unsigned int i = 0; i < n; i++) {
+    Rectangle bounds = { rand() % 1800, rand() % 1000, 50 + rand() % 400, 50 + rand() % 400 };
+    Window win = 0x400000 + i * 7;
+    whole[i].win = win;
+    whole[i].current_bounds = bounds;
+    Client c = {0};
+    clients_add(win, bounds, &c);
+  }
+
+  unsigned int queries = LOOKUPS / (n / 10 ? n / 10 : 1);
+  if (queries < 1000) {
+    queries = 1000;
+  }
+  int* xs = malloc(sizeof(int) * queries);
+  int* ys = malloc(sizeof(int) * queries);
+  Window* wins = malloc(sizeof(Window) * queries);
+  for (unsigned int i = 0; i < queries; i++) {
+    xs[i] = rand() % 1920;
+    ys[i] = rand() % 1080;
+    wins[i] = 0x400000 + (rand() % n) * 7;
+  }
+
+  unsigned long check = 0;
+  double t0 = now_ns();
+  for (unsigned int i = 0; i < queries; i++) {
+    check += whole_hit(whole, n, xs[i], ys[i]);
+  }
+  double t1 = now_ns();
+  for (unsigned int i = 0; i < queries; i++) {
+    check += split_hit(xs[i], ys[i]);
+  }
+  double t2 = now_ns();
+  for (unsigned int i = 0; i < queries; i++) {
+    check += whole_find(whole, n, wins[i]);
+  }
+  double t3 = now_ns();
+  for (unsigned int i = 0; i < queries; i++) {
+    check += split_find(wins[i]);
+  }
+  double t4 = now_ns();
+
+  double whole_h = (t1 - t0) / queries;
+  double split_h = (t2 - t1) / queries;
+  double whole_f = (t3 - t2) / queries;
+  double split_f = (t4 - t3) / queries;
+  printf("layout       n=%-6u hit test whole %9.1f ns  split %9.1f ns  (%4.1fx)  "
+         "win scan whole %9.1f ns  split %9.1f ns  (%4.1fx)  (%lu)\n",
+         n, whole_h, split_h, whole_h / split_h,
+         whole_f, split_f, whole_f / split_f, check & 1);
+
+  free(xs);
+  free(ys);
+  free(wins);
+  free(whole);
+  clients_free();
+}
+
+int main(int argc, char** argv) {
+  bench(10);
+  bench(100);
+  bench(1000);
+  bench(10000);
+  bench_focus(10);
+  bench_focus(100);
+  bench_focus(1000);
+  bench_focus(10000);
+  bench_layout(10);
+  bench_layout(100);
+  bench_layout(1000);
+  bench_layout(10000);
+  bench_layout(100000);
+}
@@ -0,0 +1,124 @@
+#include "snap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Compares the snap() scan and the maintained grid over a range of snap
+// list lengths. Moves are what a window's configure costs the grid: one
+// value out, one in. Then times each of the grid's cell scans over a range
+// of cell lengths.
+
+#define SNAP_DIST 30
+#define QUERIES 20000
+
+double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+typedef int (*SnapFn)(int x, int* xs, unsigned int n, unsigned int dist);
+
+double time_fn(SnapFn fn, int* xs, unsigned int n, int* qs, long* check) {
+  double t0 = now_ns();
+  for (unsigned int i = 0; i < QUERIES; i++) {
+    *check += fn(qs[i], xs, n, SNAP_DIST);
+  }
+  return (now_ns() - t0) / QUERIES;
+}
+
+void bench(unsigned int n) {
+  int* xs = malloc(sizeof(int) * n);
+  int* qs = malloc(sizeof(int) * QUERIES);
+  srand(n);
+  for (unsigned int i = 0; i < n; i++) {
+    xs[i] = rand() % 4000;
+  }
+  for (unsigned int i = 0; i < QUERIES; i++) {
+    qs[i] = rand() % 4000;
+  }
+
+  long check = 0;
+  printf("snap n=%-6u scan %8.1f ns", n, time_fn(snap, xs, n, qs, &check));
+
+  struct SnapGrid sg;
+  snap_grid_init(&sg, 4000, SNAP_DIST);
+  for (unsigned int i = 0; i < n; i++) {
+    snap_grid_add(&sg, xs[i], i / 2);
+  }
+  double t0 = now_ns();
+  for (unsigned int i = 0; i < QUERIES; i++) {
+    check += snap_grid_query(&sg, qs[i], SNAP_DIST, 0);
+  }
+  double grid = (now_ns() - t0) / QUERIES;
+  t0 = now_ns();
+  for (unsigned int i = 0; i < QUERIES; i++) {
+    unsigned int j = i % n;
+    snap_grid_remove(&sg, xs[j], j / 2);
+    xs[j] = qs[i];
+    snap_grid_add(&sg, xs[j], j / 2);
+  }
+  double grid_move = (now_ns() - t0) / QUERIES;
+  snap_grid_free(&sg);
+
+  printf("  grid %6.1f ns  move %6.1f ns  (%ld)\n",
+         grid, grid_move, check & 1);
+
+  free(xs);
+  free(qs);
+}
+
+double time_scan(SnapCellScan scan, struct SnapCell *cell, int* qs,
+                 long* check) {
+  double t0 = now_ns();
+  for (unsigned int i = 0; i < QUERIES; i++) {
+    *check += scan(cell, qs[i], SNAP_DIST, 0);
+  }
+  return (now_ns() - t0) / QUERIES;
+}
+
+void bench_scans(unsigned int n) {
+  int* values = malloc(sizeof(int) * n);
+  uint32_t* owners = malloc(sizeof(uint32_t) * n);
+  int* qs = malloc(sizeof(int) * QUERIES);
+  srand(n);
+  for (unsigned int i = 0; i < n; i++) {
+    values[i] = rand() % 4000;
+    owners[i] = 1 + i / 2;
+  }
+  for (unsigned int i = 0; i < QUERIES; i++) {
+    qs[i] = rand() % 4000;
+  }
+  struct SnapCell cell = { values, owners, n, n };
+
+  long check = 0;
+  printf("cell n=%-6u scalar %8.1f ns", n,
+         time_scan(snap_cell_scan_scalar, &cell, qs, &check));
+#ifdef SNAP_SIMD
+  if (__builtin_cpu_supports("sse4.1")) {
+    printf("  sse4.1 %8.1f ns",
+           time_scan(snap_cell_scan_sse41, &cell, qs, &check));
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    printf("  avx2 %8.1f ns",
+           time_scan(snap_cell_scan_avx2, &cell, qs, &check));
+  }
+#endif
+  printf("  (%ld)\n", check & 1);
+
+  free(values);
+  free(owners);
+  free(qs);
+}
+
+int main(int argc, char** argv) {
+  for (unsigned int n = 16; n <= 16384; n *= 4) {
+    bench(n);
+  }
+#ifdef SNAP_SIMD
+  __builtin_cpu_init();
+#endif
+  for (unsigned int n = 4; n <= 1024; n *= 4) {
+    bench_scans(n);
+  }
+}
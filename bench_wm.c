@@ -0,0 +1,331 @@
+#include "hist.h"
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// End-to-end benchmark. Run against a display which wm is managing (see
+// bench.sh). Creates N client windows, then drives the WM with XTest and
+// times how long it takes for the effects to come back as events.
+//
+// Results go to stdout, one "bench <metric> windows=<n> ..." line per
+// measurement, for appending to bench_output.txt.
+
+// must match wm.c
+#define MODKEY XK_Super_L
+
+// give up waiting for an event after this long
+#define WAIT_TIMEOUT_MS 2000
+
+Display *dsp;
+Window root;
+unsigned int n;
+Window *wins;
+
+long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// wait for an event of type on any of our windows (or win, if not None).
+// returns 1 if it arrived in time.
+int wait_event(int type, Window win, XEvent *out) {
+  long long deadline = now_ns() + WAIT_TIMEOUT_MS * 1000000LL;
+  while (now_ns() < deadline) {
+    while (XPending(dsp)) {
+      XEvent ev;
+      XNextEvent(dsp, &ev);
+      if (ev.type == type && (win == None || ev.xany.window == win)) {
+        if (out) {
+          *out = ev;
+        }
+        return 1;
+      }
+    }
+    struct timespec ts = { 0, 100000 };
+    nanosleep(&ts, NULL);
+  }
+  return 0;
+}
+
+// throw away anything queued
+void drain() {
+  XSync(dsp, False);
+  while (XPending(dsp)) {
+    XEvent ev;
+    XNextEvent(dsp, &ev);
+  }
+}
+
+void report(const char *metric, Histogram *h) {
+  printf("bench %s windows=%u count=%lu p50_us=%.1f p99_us=%.1f p999_us=%.1f max_us=%.1f\n",
+         metric, n, h->total,
+         hist_percentile(h, 0.5) / 1e3,
+         hist_percentile(h, 0.99) / 1e3,
+         hist_percentile(h, 0.999) / 1e3,
+         h->max / 1e3);
+}
+
+void report_rate(const char *metric, unsigned int ops, long long ns) {
+  printf("bench %s windows=%u ops=%u total_ms=%.2f ops_per_s=%.1f\n",
+         metric, n, ops, ns / 1e6, ops / (ns / 1e9));
+}
+
+Window make_client(unsigned int i) {
+  unsigned int sw = DisplayWidth(dsp, DefaultScreen(dsp));
+  unsigned int sh = DisplayHeight(dsp, DefaultScreen(dsp));
+  int x = (i * 37) % (sw - 200);
+  int y = (i * 23) % (sh - 150);
+  Window w = XCreateSimpleWindow(dsp, root, x, y, 200, 150, 0, 0, 0);
+  XSelectInput(dsp, w, StructureNotifyMask | FocusChangeMask);
+  XStoreName(dsp, w, "bench");
+  return w;
+}
+
+// map all the windows at once and time until the last MapNotify
+void bench_map() {
+  long long t0 = now_ns();
+  for (unsigned int i = 0; i < n; i++) {
+    XMapWindow(dsp, wins[i]);
+  }
+  XFlush(dsp);
+  unsigned int mapped = 0;
+  while (mapped < n && wait_event(MapNotify, None, NULL)) {
+    mapped++;
+  }
+  report_rate("map", mapped, now_ns() - t0);
+}
+
+// unmap and remap windows one at a time
+void bench_churn() {
+  Histogram *h = calloc(1, sizeof(Histogram));
+  unsigned int rounds = n < 100 ? n : 100;
+  long long t0 = now_ns();
+  for (unsigned int i = 0; i < rounds; i++) {
+    Window w = wins[i];
+    XUnmapWindow(dsp, w);
+    XFlush(dsp);
+    wait_event(UnmapNotify, w, NULL);
+
+    long long t = now_ns();
+    XMapWindow(dsp, w);
+    XFlush(dsp);
+    if (wait_event(MapNotify, w, NULL)) {
+      hist_record(h, now_ns() - t);
+    }
+  }
+  report_rate("churn", rounds, now_ns() - t0);
+  report("churn_map_latency", h);
+  free(h);
+}
+
+void key(KeySym sym, Bool press) {
+  XTestFakeKeyEvent(dsp, XKeysymToKeycode(dsp, sym), press, CurrentTime);
+}
+
+// drag the window in the middle of the screen around in a circle, timing
+// from each pointer motion to the configure it causes.
+void bench_drag() {
+  Histogram *h = calloc(1, sizeof(Histogram));
+  unsigned int sw = DisplayWidth(dsp, DefaultScreen(dsp));
+  unsigned int sh = DisplayHeight(dsp, DefaultScreen(dsp));
+
+  Window w = wins[n - 1];
+  XMoveResizeWindow(dsp, w, sw / 2 - 100, sh / 2 - 75, 200, 150);
+  XRaiseWindow(dsp, w);
+  drain();
+
+  int cx = sw / 2;
+  int cy = sh / 2;
+  XTestFakeMotionEvent(dsp, -1, cx, cy, CurrentTime);
+  key(MODKEY, True);
+  XTestFakeButtonEvent(dsp, 1, True, CurrentTime);
+  XFlush(dsp);
+
+  long long t0 = now_ns();
+  unsigned int steps = 500;
+  for (unsigned int i = 1; i <= steps; i++) {
+    // alternate between big and small steps so some motions land in the
+    // same snap and cause no configure at all
+    int dx = (i % 2 ? 7 : 1) * (i % 100 < 50 ? 1 : -1);
+    int dy = (i % 3 ? 5 : 1) * (i % 80 < 40 ? 1 : -1);
+    cx += dx;
+    cy += dy;
+    long long t = now_ns();
+    XTestFakeMotionEvent(dsp, -1, cx, cy, CurrentTime);
+    XFlush(dsp);
+    XEvent ev;
+    if (wait_event(ConfigureNotify, w, &ev)) {
+      hist_record(h, now_ns() - t);
+    }
+  }
+  XTestFakeButtonEvent(dsp, 1, False, CurrentTime);
+  key(MODKEY, False);
+  XFlush(dsp);
+  report_rate("drag", steps, now_ns() - t0);
+  report("drag_configure_latency", h);
+  free(h);
+  drain();
+}
+
+// tap the mod key to cycle through candidates, counting the focus and
+// stacking events our windows see along the way. cycling should only
+// change borders, so the focus change and restack come once, when the
+// switch is finalized.
+void bench_switch() {
+  // not a multiple of n, or we'd end up back where we started and focus
+  // wouldn't move at all
+  unsigned int taps = n <= 50 ? n - 1 : 50;
+  if (!taps) {
+    return;
+  }
+  unsigned int focus_events = 0;
+  unsigned int restacks = 0;
+  drain();
+  long long t0 = now_ns();
+  for (unsigned int i = 0; i < taps; i++) {
+    key(MODKEY, True);
+    key(MODKEY, False);
+    XSync(dsp, False);
+    while (XPending(dsp)) {
+      XEvent ev;
+      XNextEvent(dsp, &ev);
+      if (ev.type == FocusIn || ev.type == FocusOut) {
+        focus_events++;
+      } else if (ev.type == ConfigureNotify) {
+        restacks++;
+      }
+    }
+  }
+  report_rate("switch_taps", taps, now_ns() - t0);
+  printf("bench switch_cycle windows=%u taps=%u focus_events=%u restacks=%u\n",
+         n, taps, focus_events, restacks);
+
+  // timed from the last tap, so mostly the timeout
+  long long t = now_ns();
+  int finalized = wait_event(FocusIn, None, NULL);
+  printf("bench switch_finalize windows=%u ok=%d ms=%.1f\n",
+         n, finalized, (now_ns() - t) / 1e6);
+  drain();
+}
+
+// toggle maximize on the focused window, timing until it's configured
+void bench_maximize() {
+  Histogram *h = calloc(1, sizeof(Histogram));
+  unsigned int toggles = 50;
+  for (unsigned int i = 0; i < toggles; i++) {
+    long long t = now_ns();
+    key(MODKEY, True);
+    key(XK_m, True);
+    key(XK_m, False);
+    key(MODKEY, False);
+    XFlush(dsp);
+    if (wait_event(ConfigureNotify, None, NULL)) {
+      hist_record(h, now_ns() - t);
+    }
+  }
+  report("maximize_latency", h);
+  free(h);
+}
+
+// send half the windows to workspace 2, then switch back and forth,
+// timing from the key press until every window has been shown or hidden
+void bench_workspaces() {
+  Histogram *h = calloc(1, sizeof(Histogram));
+  drain();
+
+  // the focused window goes each time, and focus moves on to another
+  unsigned int sent = 0;
+  for (unsigned int i = 0; i < n / 2; i++) {
+    key(MODKEY, True);
+    key(XK_Shift_L, True);
+    key(XK_2, True);
+    key(XK_2, False);
+    key(XK_Shift_L, False);
+    key(MODKEY, False);
+    XFlush(dsp);
+    if (wait_event(UnmapNotify, None, NULL)) {
+      sent++;
+    }
+  }
+  drain();
+
+  // ends back on workspace 1
+  unsigned int rounds = 20;
+  for (unsigned int i = 0; i < rounds; i++) {
+    KeySym target = i % 2 ? XK_1 : XK_2;
+    long long t = now_ns();
+    key(MODKEY, True);
+    key(target, True);
+    key(target, False);
+    key(MODKEY, False);
+    XFlush(dsp);
+
+    unsigned int seen = 0;
+    long long deadline = now_ns() + WAIT_TIMEOUT_MS * 1000000LL;
+    while (seen < n && now_ns() < deadline) {
+      while (XPending(dsp)) {
+        XEvent ev;
+        XNextEvent(dsp, &ev);
+        if (ev.type == MapNotify || ev.type == UnmapNotify) {
+          seen++;
+        }
+      }
+      struct timespec ts = { 0, 100000 };
+      nanosleep(&ts, NULL);
+    }
+    if (seen == n) {
+      hist_record(h, now_ns() - t);
+    }
+  }
+  printf("bench workspace_send windows=%u sent=%u\n", n, sent);
+  report("workspace_switch_latency", h);
+  free(h);
+  drain();
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s windows\n", argv[0]);
+    return 1;
+  }
+  n = atoi(argv[1]);
+  if (n < 1) {
+    n = 1;
+  }
+
+  dsp = XOpenDisplay(NULL);
+  if (!dsp) {
+    fprintf(stderr, "could not open display\n");
+    return 1;
+  }
+  int ev, er, maj, min;
+  if (!XTestQueryExtension(dsp, &ev, &er, &maj, &min)) {
+    fprintf(stderr, "no XTest extension\n");
+    return 1;
+  }
+  root = DefaultRootWindow(dsp);
+
+  wins = malloc(sizeof(Window) * n);
+  for (unsigned int i = 0; i < n; i++) {
+    wins[i] = make_client(i);
+  }
+
+  bench_map();
+  bench_churn();
+  bench_drag();
+  bench_switch();
+  bench_maximize();
+  bench_workspaces();
+
+  for (unsigned int i = 0; i < n; i++) {
+    XDestroyWindow(dsp, wins[i]);
+  }
+  XCloseDisplay(dsp);
+  free(wins);
+}
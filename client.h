@@ -3,26 +3,66 @@
 
 #include <X11/Xlib.h>
 
+// end of the focus history list
+#define FOCUS_NIL ((unsigned int)-1)
+
+// end of the stacking order
+#define STACK_NIL ((unsigned int)-1)
+
 typedef struct {
   int x, y, w, h;
 } Rectangle;
 
+// The parts of a client which aren't looked at on every event. The window
+// and its current bounds are kept in packed arrays alongside (see
+// clients.h) so scans over them stay in as few cache lines as possible.
 typedef struct {
-  Rectangle current_bounds;
-
   // bounds without any maximization applied.
   // only non-zero after a maximization has been applied.
   Rectangle orig_bounds;
 
-  Window win;
-
   // maximization state
   char max_state;
 
   // flag to track border toggle state (via current border width)
   char border_width;
 
+  // window title, utf-8 if it came from _NET_WM_NAME. only fetched when
+  // something wants to show it. the storage is reused across updates; see
+  // client_set_name.
   char* name;
+  unsigned int name_cap;
+
+  // the title has changed since it was last fetched
+  char name_dirty;
+
+  // which workspace it's on. see clients_move_to_workspace.
+  unsigned char workspace;
+
+  // indexes of the neighbouring clients in its workspace's focus history.
+  // maintained by clients.c.
+  unsigned int focus_prev, focus_next;
+
+  // indexes of the clients directly above and below it in the stacking
+  // order. maintained by clients.c.
+  unsigned int stack_above, stack_below;
+
+  // unmaps we've asked for which haven't been notified yet. maintained by
+  // wm.c so that our own hiding isn't taken for the client going away.
+  unsigned int unmaps_expected;
+
+  // what we last asked the server for, or what it last told us. maintained
+  // by xreq.c.
+  Rectangle sent_bounds;
+  unsigned long sent_border_colour;
+  char sent_border_colour_known;
+  char sent_border_width;
+  // request number of the latest of those requests
+  unsigned long sent_serial;
+
+  // 1 + its entry in xreq.c's stacking changes waiting to be sent, or 0
+  // if it has none
+  unsigned int stack_op;
 } Client;
 
 // Pair of pointer and array index.
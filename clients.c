@@ -1,9 +1,70 @@
 #include "clients.h"
+#include "winindex.h"
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// smallest allocation for a client's title
+#define NAME_MIN_CAP 32
 
 struct ClientBuffer clients;
-struct WindowBuffer window_focus_history;
+struct WindowBuffer clients_wins;
+struct RectBuffer clients_bounds;
+
+// maps a client's window to its index in clients
+static struct WinIndex client_index;
+
+// Each workspace's focus history is a doubly-linked list threaded through
+// the clients buffer by index (see focus_prev/focus_next in Client). Most
+// recently focused first. A client is on the list of its workspace, so
+// the lists are also the workspaces' membership.
+typedef struct {
+  unsigned int head;
+  unsigned int tail;
+  unsigned int length;
+} FocusList;
+
+static FocusList lists[WORKSPACES];
+
+// the workspace whose history window_history_get walks
+static unsigned int current;
+
+// Remembers where the last window_history_get landed so walking the
+// history in order (as window switching does) is O(1) per step.
+static unsigned int cursor_pos;
+static unsigned int cursor_node = FOCUS_NIL;
+
+// The stacking order is another list threaded through the buffer, this one
+// through every client (see stack_above/stack_below in Client).
+static unsigned int stack_top = STACK_NIL;
+static unsigned int stack_bottom = STACK_NIL;
+
+void clients_init(unsigned long capacity) {
+  cb_init(&clients, capacity);
+  wb_init(&clients_wins, capacity);
+  rb_init(&clients_bounds, capacity);
+  wi_init(&client_index, capacity);
+  for (unsigned int i = 0; i < WORKSPACES; i++) {
+    lists[i].head = FOCUS_NIL;
+    lists[i].tail = FOCUS_NIL;
+    lists[i].length = 0;
+  }
+  current = 0;
+  cursor_node = FOCUS_NIL;
+  stack_top = STACK_NIL;
+  stack_bottom = STACK_NIL;
+}
+
+void clients_free() {
+  for (unsigned int i = 0; i < clients.length; i++) {
+    free(cb_get(&clients, i)->name);
+  }
+  cb_free(&clients);
+  wb_free(&clients_wins);
+  rb_free(&clients_bounds);
+  wi_free(&client_index);
+}
 
 // Finds a client by the window it represents.
 PI clients_find(Window win) {
@@ -11,27 +72,187 @@ PI clients_find(Window win) {
     .data = NULL,
     .index = 0,
   };
-  for (unsigned int i = 0; i < clients.length; i++) {
-    Client *c = cb_get(&clients, i);
-    if (c->win == win) {
-      p.data = c;
-      p.index = i;
-    }
+  unsigned int i;
+  if (wi_get(&client_index, win, &i)) {
+    p.data = cb_get(&clients, i);
+    p.index = i;
   }
   return p;
 }
 
+static Client* node(unsigned int i) {
+  return cb_get(&clients, i);
+}
+
+static unsigned int index_of(Client *c) {
+  assert(c >= clients.data && c < clients.data + clients.length);
+  return c - clients.data;
+}
+
+Window client_win(Client *c) {
+  return *wb_get(&clients_wins, index_of(c));
+}
+
+Rectangle* client_bounds(Client *c) {
+  return rb_get(&clients_bounds, index_of(c));
+}
+
+static FocusList* list_of(unsigned int i) {
+  return &lists[node(i)->workspace];
+}
+
+static void focus_unlink(unsigned int i) {
+  Client *c = node(i);
+  FocusList *l = list_of(i);
+  if (c->focus_prev == FOCUS_NIL) {
+    l->head = c->focus_next;
+  } else {
+    node(c->focus_prev)->focus_next = c->focus_next;
+  }
+  if (c->focus_next == FOCUS_NIL) {
+    l->tail = c->focus_prev;
+  } else {
+    node(c->focus_next)->focus_prev = c->focus_prev;
+  }
+  c->focus_prev = FOCUS_NIL;
+  c->focus_next = FOCUS_NIL;
+  l->length--;
+  cursor_node = FOCUS_NIL;
+}
+
+static void focus_push_front(unsigned int i) {
+  Client *c = node(i);
+  FocusList *l = list_of(i);
+  c->focus_prev = FOCUS_NIL;
+  c->focus_next = l->head;
+  if (l->head == FOCUS_NIL) {
+    l->tail = i;
+  } else {
+    node(l->head)->focus_prev = i;
+  }
+  l->head = i;
+  l->length++;
+  cursor_node = FOCUS_NIL;
+}
+
+static void focus_push_back(unsigned int i) {
+  Client *c = node(i);
+  FocusList *l = list_of(i);
+  c->focus_next = FOCUS_NIL;
+  c->focus_prev = l->tail;
+  if (l->tail == FOCUS_NIL) {
+    l->head = i;
+  } else {
+    node(l->tail)->focus_next = i;
+  }
+  l->tail = i;
+  l->length++;
+  cursor_node = FOCUS_NIL;
+}
+
+// The client at index to has just been moved there from elsewhere in the
+// buffer. Point its neighbours at the new location.
+static void focus_relocate(unsigned int to) {
+  Client *c = node(to);
+  FocusList *l = list_of(to);
+  if (c->focus_prev == FOCUS_NIL) {
+    l->head = to;
+  } else {
+    node(c->focus_prev)->focus_next = to;
+  }
+  if (c->focus_next == FOCUS_NIL) {
+    l->tail = to;
+  } else {
+    node(c->focus_next)->focus_prev = to;
+  }
+  cursor_node = FOCUS_NIL;
+}
+
+static void stack_unlink(unsigned int i) {
+  Client *c = node(i);
+  if (c->stack_above == STACK_NIL) {
+    stack_top = c->stack_below;
+  } else {
+    node(c->stack_above)->stack_below = c->stack_below;
+  }
+  if (c->stack_below == STACK_NIL) {
+    stack_bottom = c->stack_above;
+  } else {
+    node(c->stack_below)->stack_above = c->stack_above;
+  }
+  c->stack_above = STACK_NIL;
+  c->stack_below = STACK_NIL;
+}
+
+static void stack_push_top(unsigned int i) {
+  Client *c = node(i);
+  c->stack_above = STACK_NIL;
+  c->stack_below = stack_top;
+  if (stack_top == STACK_NIL) {
+    stack_bottom = i;
+  } else {
+    node(stack_top)->stack_above = i;
+  }
+  stack_top = i;
+}
+
+static void stack_push_bottom(unsigned int i) {
+  Client *c = node(i);
+  c->stack_below = STACK_NIL;
+  c->stack_above = stack_bottom;
+  if (stack_bottom == STACK_NIL) {
+    stack_top = i;
+  } else {
+    node(stack_bottom)->stack_below = i;
+  }
+  stack_bottom = i;
+}
+
+// as focus_relocate, for the stacking order
+static void stack_relocate(unsigned int to) {
+  Client *c = node(to);
+  if (c->stack_above == STACK_NIL) {
+    stack_top = to;
+  } else {
+    node(c->stack_above)->stack_below = to;
+  }
+  if (c->stack_below == STACK_NIL) {
+    stack_bottom = to;
+  } else {
+    node(c->stack_below)->stack_above = to;
+  }
+}
+
 // Finds the client which was most recently focused.
 PI clients_most_recent() {
-  Window* w = wb_get(&window_focus_history, 0);
-  return clients_find(*w);
+  return clients_find(window_history_get(0));
 }
 
-void clients_add(Client* c) {
+void clients_add(Window win, Rectangle bounds, Client* c) {
   assert(c);
+  assert(c->workspace < WORKSPACES);
   cb_add(&clients, c);
-  wb_add(&window_focus_history, &c->win);
-  assert(clients.length == window_focus_history.length);
+  wb_add(&clients_wins, &win);
+  rb_add(&clients_bounds, &bounds);
+  unsigned int i = clients.length - 1;
+  wi_put(&client_index, win, i);
+  focus_push_back(i);
+  stack_push_top(i);
+}
+
+void client_set_name(Client *c, const char *name, unsigned int len) {
+  if (len + 1 > c->name_cap) {
+    unsigned int cap = c->name_cap ? c->name_cap : NAME_MIN_CAP;
+    while (cap < len + 1) {
+      cap *= 2;
+    }
+    char *grown = realloc(c->name, cap);
+    assert(grown);
+    c->name = grown;
+    c->name_cap = cap;
+  }
+  memcpy(c->name, name, len);
+  c->name[len] = '\0';
 }
 
 void clients_del(Window win) {
@@ -41,43 +262,148 @@ void clients_del(Window win) {
   }
 
   Client *c = p.data;
-  XFree(c->name);
+  free(c->name);
+
+  focus_unlink(p.index);
+  stack_unlink(p.index);
 
+  // removal moves the last client into the vacated slot, in all three
+  // buffers alike
+  unsigned int last = clients.length - 1;
   cb_remove(&clients, p.index);
+  wb_remove(&clients_wins, p.index);
+  rb_remove(&clients_bounds, p.index);
+  wi_del(&client_index, win);
+  if (p.index != last) {
+    wi_put(&client_index, *wb_get(&clients_wins, p.index), p.index);
+    focus_relocate(p.index);
+    stack_relocate(p.index);
+  }
+}
+
+Window window_history_get(unsigned int i) {
+  FocusList *l = &lists[current];
+  if (i >= l->length) {
+    return None;
+  }
 
-  for (unsigned int i = 0; i < window_focus_history.length; i++) {
-    Window* w = wb_get(&window_focus_history, i);
-    if (win == *w) {
-      wb_remove(&window_focus_history, i);
-      break;
+  // start from whichever known position is closest: either end, or
+  // wherever the last lookup finished.
+  unsigned int pos = 0;
+  unsigned int n = l->head;
+  unsigned int dist = i;
+  unsigned int back = l->length - 1 - i;
+  if (back < dist) {
+    pos = l->length - 1;
+    n = l->tail;
+    dist = back;
+  }
+  if (cursor_node != FOCUS_NIL) {
+    unsigned int d = cursor_pos < i ? i - cursor_pos : cursor_pos - i;
+    if (d < dist) {
+      pos = cursor_pos;
+      n = cursor_node;
     }
   }
 
-  assert(clients.length == window_focus_history.length);
+  for (; pos < i; pos++) {
+    n = node(n)->focus_next;
+  }
+  for (; pos > i; pos--) {
+    n = node(n)->focus_prev;
+  }
+
+  cursor_pos = i;
+  cursor_node = n;
+  return *wb_get(&clients_wins, n);
 }
 
-// todo - code-gen a typed interface onto the buffer
-Window window_history_get(unsigned int i) {
-  Window *w = wb_get(&window_focus_history, i);
-  return *w;
+unsigned int window_history_length() {
+  return lists[current].length;
 }
 
 void clients_focus_raise(Window win) {
-  for (unsigned int i = 0; i < window_focus_history.length; i++) {
-    Window w = window_history_get(i);
-    if (win == w) {
-      wb_bring_to_front(&window_focus_history, i);
-      return;
-    }
+  PI p = clients_find(win);
+  if (!p.data || list_of(p.index)->head == p.index) {
+    return;
   }
+  focus_unlink(p.index);
+  focus_push_front(p.index);
 }
 
 void clients_focus_lower(Window win) {
-  for (unsigned int i = 0; i < window_focus_history.length; i++) {
-    Window w = window_history_get(i);
-    if (win == w) {
-      wb_send_to_back(&window_focus_history, i);
-      return;
-    }
+  PI p = clients_find(win);
+  if (!p.data || list_of(p.index)->tail == p.index) {
+    return;
+  }
+  focus_unlink(p.index);
+  focus_push_back(p.index);
+}
+
+unsigned int clients_workspace() {
+  return current;
+}
+
+void clients_set_workspace(unsigned int ws) {
+  assert(ws < WORKSPACES);
+  current = ws;
+  cursor_node = FOCUS_NIL;
+}
+
+unsigned int clients_workspace_length(unsigned int ws) {
+  assert(ws < WORKSPACES);
+  return lists[ws].length;
+}
+
+void clients_move_to_workspace(Window win, unsigned int ws) {
+  assert(ws < WORKSPACES);
+  PI p = clients_find(win);
+  if (!p.data || p.data->workspace == ws) {
+    return;
+  }
+  focus_unlink(p.index);
+  p.data->workspace = ws;
+  focus_push_front(p.index);
+}
+
+static Window win_at(unsigned int i) {
+  return i == STACK_NIL ? None : *wb_get(&clients_wins, i);
+}
+
+Window clients_stack_top() {
+  return win_at(stack_top);
+}
+
+Window clients_stack_bottom() {
+  return win_at(stack_bottom);
+}
+
+Window clients_stack_below(Window win) {
+  PI p = clients_find(win);
+  return p.data ? win_at(p.data->stack_below) : None;
+}
+
+Window clients_stack_above(Window win) {
+  PI p = clients_find(win);
+  return p.data ? win_at(p.data->stack_above) : None;
+}
+
+char clients_stack_raise(Window win) {
+  PI p = clients_find(win);
+  if (!p.data || stack_top == p.index) {
+    return 0;
+  }
+  stack_unlink(p.index);
+  stack_push_top(p.index);
+  return 1;
+}
+
+char clients_stack_lower(Window win) {
+  PI p = clients_find(win);
+  if (!p.data || stack_bottom == p.index) {
+    return 0;
   }
+  stack_unlink(p.index);
+  stack_push_bottom(p.index);
+  return 1;
 }
@@ -3,23 +3,77 @@
 
 #include "clientbuffer.h"
 #include "windowbuffer.h"
+#include "rectbuffer.h"
 #include "client.h"
 #include <X11/Xlib.h>
 
 // todo hide these away
+//
+// Client storage is split three ways, all indexed the same: the windows,
+// their current bounds, and everything else. The first two are what gets
+// scanned, so they're packed on their own.
 extern struct ClientBuffer clients;
-extern struct WindowBuffer window_focus_history;
+extern struct WindowBuffer clients_wins;
+extern struct RectBuffer clients_bounds;
 
-void clients_add(Client *c);
+// Clients are each on one of WORKSPACES workspaces, which have their own
+// focus histories. The history functions below are about the current
+// workspace.
+#define WORKSPACES 9
+
+// allocate storage for the client list and its indexes
+void clients_init(unsigned long capacity);
+void clients_free();
+
+// add a client for win. the rest of the client's data, including its
+// workspace, is copied from c. it goes to the back of its workspace's
+// focus history.
+void clients_add(Window win, Rectangle bounds, Client *c);
 void clients_del(Window win);
 
 PI clients_find(Window win);
 PI clients_most_recent();
 
+// replace a client's title with the first len bytes of name. its storage
+// is only reallocated when the new title doesn't fit.
+void client_set_name(Client *c, const char *name, unsigned int len);
+
+// the window and current bounds of a client in clients. the pointer is
+// good until the next add or delete.
+Window client_win(Client *c);
+Rectangle* client_bounds(Client *c);
+
+// the i'th most recently focused window, or None if there are fewer.
+// cheap for i near either end of the history, or near the previous
+// call's i.
 Window window_history_get(unsigned int i);
 
+// number of windows in the history
+unsigned int window_history_length();
+
 // raise/lower win to the top/back of the focus history list
 void clients_focus_raise(Window win);
 void clients_focus_lower(Window win);
 
+unsigned int clients_workspace();
+void clients_set_workspace(unsigned int ws);
+unsigned int clients_workspace_length(unsigned int ws);
+
+// move win to the front of ws's focus history
+void clients_move_to_workspace(Window win, unsigned int ws);
+
+// The stacking order of every client, across all workspaces. New clients
+// go on top. This is our record of the order, not the server's; see
+// xreq.h for how the two are kept in step.
+Window clients_stack_top();
+Window clients_stack_bottom();
+
+// the window directly below/above win, or None at the end
+Window clients_stack_below(Window win);
+Window clients_stack_above(Window win);
+
+// move win to the top/bottom. returns whether the order changed.
+char clients_stack_raise(Window win);
+char clients_stack_lower(Window win);
+
 #endif
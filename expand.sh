@@ -45,3 +45,12 @@ type=Window
 structname=WindowBuffer
 prefix=wb
 expand_templates
+
+header=rectbuffer.h
+headerdef=RECTBUFFER_H
+extraheader='#include "client.h"'
+src=rectbuffer.c
+type=Rectangle
+structname=RectBuffer
+prefix=rb
+expand_templates
@@ -0,0 +1,55 @@
+#include "hist.h"
+#include <string.h>
+
+static unsigned int bucket(unsigned long long v) {
+  if (v < HIST_SUB) {
+    return v;
+  }
+  unsigned int m = 63 - __builtin_clzll(v);
+  unsigned int shift = m - HIST_SUB_BITS;
+  unsigned int sub = (v >> shift) - HIST_SUB;
+  return HIST_SUB + shift * HIST_SUB + sub;
+}
+
+// largest value which falls in bucket i
+static unsigned long long bucket_max(unsigned int i) {
+  if (i < HIST_SUB) {
+    return i;
+  }
+  unsigned int shift = (i - HIST_SUB) / HIST_SUB;
+  unsigned long long sub = (i - HIST_SUB) % HIST_SUB;
+  unsigned long long lower = (HIST_SUB + sub) << shift;
+  return lower + ((1ULL << shift) - 1);
+}
+
+void hist_record(Histogram *h, unsigned long long value) {
+  h->counts[bucket(value)]++;
+  h->total++;
+  if (value > h->max) {
+    h->max = value;
+  }
+}
+
+unsigned long long hist_percentile(Histogram *h, double p) {
+  if (!h->total) {
+    return 0;
+  }
+  unsigned long long want = p * h->total + 0.5;
+  if (want < 1) {
+    want = 1;
+  }
+  unsigned long long seen = 0;
+  for (unsigned int i = 0; i < HIST_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= want) {
+      // never report more than was actually seen
+      unsigned long long v = bucket_max(i);
+      return v < h->max ? v : h->max;
+    }
+  }
+  return h->max;
+}
+
+void hist_reset(Histogram *h) {
+  memset(h, 0, sizeof(*h));
+}
@@ -0,0 +1,28 @@
+#ifndef HIST_H
+#define HIST_H
+
+// A log-linear histogram in the style of HdrHistogram.
+//
+// Values below 16 get a bucket each. Above that, each power of two is split
+// into 16 equal buckets, so any recorded value is known to within 1/16 of
+// itself, over the whole 64-bit range, in a fixed 8k of counts.
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (HIST_SUB + (64 - HIST_SUB_BITS) * HIST_SUB)
+
+typedef struct {
+  unsigned long counts[HIST_BUCKETS];
+  unsigned long total;
+  unsigned long long max;
+} Histogram;
+
+void hist_record(Histogram *h, unsigned long long value);
+
+// the smallest value v such that at least fraction p (0 to 1) of the
+// recorded values are <= v, to within the bucket resolution. 0 if empty.
+unsigned long long hist_percentile(Histogram *h, double p);
+
+void hist_reset(Histogram *h);
+
+#endif
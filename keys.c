@@ -0,0 +1,236 @@
+#include "keys.h"
+#include "log.h"
+#include "timers.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// keycodes are 8 bits, and only the KEYS_MODS modifiers matter
+#define KEY_CODES 256
+#define MOD_COMBOS (1 << __builtin_popcount(KEYS_MODS))
+#define TABLE_SIZE (KEY_CODES * MOD_COMBOS)
+
+#define ROOT 0
+
+// 0 is the root, which is never anyone's child, so it marks no child.
+typedef unsigned short NodeRef;
+
+typedef struct {
+  KeyFn fn;
+  KeyFn hold;
+  // index into tables, or -1 if there are no children
+  int table;
+} Node;
+
+static Node *nodes = NULL;
+static unsigned int nodes_len, nodes_cap;
+
+static NodeRef *tables = NULL;
+static unsigned int tables_len, tables_cap;
+
+static KeyGrabFn grab;
+static long long seq_timeout_us;
+static long long hold_us;
+
+// where the sequence in progress has got to
+static NodeRef cur = ROOT;
+
+// a binding with a hold fn whose key is down
+static NodeRef held = ROOT;
+static KeyCode held_kc;
+
+static Timer seq_timer;
+static Timer hold_timer;
+
+// pack state's KEYS_MODS bits together, dropping any others. KEYS_MODS is
+// constant, so the loop unrolls away.
+static unsigned int mod_index(unsigned int state) {
+  unsigned int index = 0;
+  unsigned int bit = 1;
+  for (unsigned int mods = KEYS_MODS; mods; mods &= mods - 1) {
+    if (state & mods & -mods) {
+      index |= bit;
+    }
+    bit <<= 1;
+  }
+  return index;
+}
+
+static NodeRef child(NodeRef n, KeyCode kc, unsigned int state) {
+  int t = nodes[n].table;
+  if (t < 0) {
+    return ROOT;
+  }
+  return tables[t * TABLE_SIZE + kc * MOD_COMBOS + mod_index(state)];
+}
+
+static NodeRef add_node() {
+  if (nodes_len == nodes_cap) {
+    nodes_cap = nodes_cap ? nodes_cap * 2 : 16;
+    nodes = realloc(nodes, sizeof(Node) * nodes_cap);
+    assert(nodes);
+  }
+  assert(nodes_len < (NodeRef)-1);
+  Node *n = &nodes[nodes_len];
+  n->fn = NULL;
+  n->hold = NULL;
+  n->table = -1;
+  return nodes_len++;
+}
+
+static void add_table(NodeRef n) {
+  if (tables_len == tables_cap) {
+    tables_cap = tables_cap ? tables_cap * 2 : 4;
+    tables = realloc(tables, sizeof(NodeRef) * TABLE_SIZE * tables_cap);
+    assert(tables);
+  }
+  memset(&tables[tables_len * TABLE_SIZE], 0, sizeof(NodeRef) * TABLE_SIZE);
+  nodes[n].table = tables_len++;
+}
+
+// back to the root, letting go of the keyboard if a sequence had it
+static void end_sequence() {
+  timer_cancel(&seq_timer);
+  if (cur != ROOT) {
+    cur = ROOT;
+    grab(0);
+  }
+}
+
+static void seq_timeout() {
+  KeyFn fn = nodes[cur].fn;
+  end_sequence();
+  if (fn) {
+    fn();
+  }
+}
+
+// the held key has come up, or was held long enough
+static void resolve_hold(char long_press) {
+  KeyFn fn = long_press ? nodes[held].hold : nodes[held].fn;
+  timer_cancel(&hold_timer);
+  held = ROOT;
+  end_sequence();
+  if (fn) {
+    fn();
+  }
+}
+
+static void hold_timeout() {
+  resolve_hold(1);
+}
+
+void keys_init(KeyGrabFn g, long long seq_us, long long h_us) {
+  grab = g;
+  seq_timeout_us = seq_us;
+  hold_us = h_us;
+  seq_timer.fn = seq_timeout;
+  hold_timer.fn = hold_timeout;
+}
+
+void keys_free() {
+  free(nodes);
+  free(tables);
+  nodes = NULL;
+  tables = NULL;
+  nodes_len = nodes_cap = 0;
+  tables_len = tables_cap = 0;
+}
+
+void keys_build(const KeyBinding *bindings, unsigned int count,
+                KeyCodeFn to_keycode) {
+  timer_cancel(&hold_timer);
+  held = ROOT;
+  end_sequence();
+
+  nodes_len = 0;
+  tables_len = 0;
+  add_node();
+
+  for (unsigned int i = 0; i < count; i++) {
+    const KeyBinding *b = &bindings[i];
+    NodeRef n = ROOT;
+    for (unsigned int s = 0; s < KEYS_SEQ_MAX && b->strokes[s].sym != NoSymbol; s++) {
+      KeyCode kc = to_keycode(b->strokes[s].sym);
+      if (!kc) {
+        WARN("no keycode for keysym %lx", b->strokes[s].sym);
+        n = ROOT;
+        break;
+      }
+      if (nodes[n].table < 0) {
+        add_table(n);
+      }
+      unsigned int slot = nodes[n].table * TABLE_SIZE +
+        kc * MOD_COMBOS + mod_index(b->strokes[s].mods);
+      if (!tables[slot]) {
+        tables[slot] = add_node();
+      }
+      n = tables[slot];
+    }
+    if (n == ROOT) {
+      continue;
+    }
+    if (nodes[n].fn || nodes[n].hold) {
+      WARN("binding %d replaces an earlier one", i);
+    }
+    nodes[n].fn = b->fn;
+    nodes[n].hold = b->hold;
+  }
+
+  FINE("%d key bindings in %d nodes and %d tables",
+       count, nodes_len, tables_len);
+}
+
+char keys_press(KeyCode kc, unsigned int state) {
+  if (!nodes_len) {
+    // not built yet
+    return 0;
+  }
+
+  if (held != ROOT) {
+    // another key before the held one came up. count it as a tap.
+    resolve_hold(0);
+  }
+
+  NodeRef next = child(cur, kc, state);
+  if (!next && cur != ROOT) {
+    // not part of the sequence in progress. abandon it and start over.
+    end_sequence();
+    next = child(ROOT, kc, state);
+  }
+  if (!next) {
+    return 0;
+  }
+
+  Node *n = &nodes[next];
+  if (n->table >= 0) {
+    if (cur == ROOT) {
+      grab(1);
+    }
+    cur = next;
+    timer_set(&seq_timer, seq_timeout_us);
+    return 1;
+  }
+
+  if (n->hold) {
+    // keep any sequence's grab so we see the release
+    timer_cancel(&seq_timer);
+    held = next;
+    held_kc = kc;
+    timer_set(&hold_timer, hold_us);
+    return 1;
+  }
+
+  KeyFn fn = n->fn;
+  end_sequence();
+  if (fn) {
+    fn();
+  }
+  return 1;
+}
+
+void keys_release(KeyCode kc) {
+  if (held != ROOT && kc == held_kc) {
+    resolve_hold(0);
+  }
+}
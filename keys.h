@@ -0,0 +1,57 @@
+#ifndef KEYS_H
+#define KEYS_H
+
+#include <X11/Xlib.h>
+
+// Key bindings, including sequences of keys and keys held down.
+//
+// Bindings are compiled into a trie. Every node with children has a table
+// indexed by keycode and modifier state, so each keystroke is one lookup
+// however many bindings there are. The tables are in terms of keycodes,
+// so they're rebuilt whenever the keyboard mapping changes.
+//
+// A node may be both a binding and the prefix of longer ones, in which
+// case its binding runs if nothing follows within the sequence timeout.
+// A binding with a hold fn runs fn if the key is released before the hold
+// timeout, and hold otherwise.
+
+// longest key sequence
+#define KEYS_SEQ_MAX 4
+
+typedef void (*KeyFn)();
+
+typedef struct {
+  KeySym sym;
+  unsigned int mods;
+} KeyStroke;
+
+typedef struct {
+  // strokes end at KEYS_SEQ_MAX or the first with NoSymbol
+  KeyStroke strokes[KEYS_SEQ_MAX];
+  KeyFn fn;
+  KeyFn hold;
+} KeyBinding;
+
+// the modifiers which tell bindings apart. lock and num-lock aren't
+// among them.
+#define KEYS_MODS (ShiftMask | ControlMask | Mod1Mask | Mod4Mask)
+
+// called with 1 when a sequence starts, and 0 when it's over. all keys
+// should go to us in between.
+typedef void (*KeyGrabFn)(char grab);
+
+typedef KeyCode (*KeyCodeFn)(KeySym sym);
+
+void keys_init(KeyGrabFn grab, long long seq_timeout_us, long long hold_us);
+void keys_free();
+
+// (re)build the trie from bindings, with keysyms looked up by to_keycode.
+// any sequence in progress is abandoned.
+void keys_build(const KeyBinding *bindings, unsigned int count,
+                KeyCodeFn to_keycode);
+
+// returns whether the key was bound, or continued a sequence
+char keys_press(KeyCode kc, unsigned int state);
+void keys_release(KeyCode kc);
+
+#endif
@@ -0,0 +1,192 @@
+#include "log.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+// must be a power of two
+#define RING_SLOTS 1024
+#define MSG_LEN 200
+
+typedef struct {
+  struct timespec ts;
+  const char* fn;
+  char msg[MSG_LEN];
+} Entry;
+
+// single producer (whoever calls log_msg, which is only ever the event
+// thread), single consumer (the writer thread). head and tail only ever
+// increase; slot = counter % RING_SLOTS.
+static Entry ring[RING_SLOTS];
+static unsigned long head = 0; // next slot to write, owned by producer
+static unsigned long tail = 0; // next slot to read, owned by consumer
+
+// messages dropped because the ring was full. producer only.
+static unsigned long dropped = 0;
+
+// the writer sets this before sleeping on wake_fd. the producer only
+// pays for a wake-up syscall when it's set.
+static int writer_sleeping = 0;
+static int wake_fd = -1;
+
+// the producer bumps sync_requested and waits on synced_fd until the
+// writer has caught up.
+static int synced_fd = -1;
+static int sync_requested = 0;
+
+static int started = 0;
+
+static void wake_writer() {
+  if (__atomic_exchange_n(&writer_sleeping, 0, __ATOMIC_SEQ_CST)) {
+    uint64_t one = 1;
+    ssize_t r = write(wake_fd, &one, sizeof(one));
+    (void)r;
+  }
+}
+
+// append the formatted form of e to out, returning the new length.
+static size_t format_entry(char* out, size_t len, size_t cap, Entry* e) {
+  struct tm gmt;
+  gmtime_r(&e->ts.tv_sec, &gmt);
+  char stamp[64];
+  strftime(stamp, sizeof(stamp), "%F %T", &gmt);
+  int n = snprintf(out + len, cap - len, "%s.%03d %s - %s\n",
+                   stamp, (int)(e->ts.tv_nsec / 1000000), e->fn, e->msg);
+  if (n < 0) {
+    return len;
+  }
+  return len + ((size_t)n < cap - len ? (size_t)n : cap - len - 1);
+}
+
+static void write_all(char* buf, size_t len) {
+  while (len) {
+    ssize_t n = write(STDOUT_FILENO, buf, len);
+    if (n <= 0) {
+      return;
+    }
+    buf += n;
+    len -= n;
+  }
+}
+
+// write out everything in the ring. returns whether there was anything.
+static int drain() {
+  static char out[RING_SLOTS * (MSG_LEN + 64)];
+  unsigned long h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+  unsigned long t = tail;
+  if (t == h) {
+    return 0;
+  }
+  size_t len = 0;
+  for (; t != h; t++) {
+    len = format_entry(out, len, sizeof(out), &ring[t % RING_SLOTS]);
+  }
+  __atomic_store_n(&tail, t, __ATOMIC_RELEASE);
+  write_all(out, len);
+  return 1;
+}
+
+static void* writer(void* arg) {
+  int synced = 0;
+  for (;;) {
+    // look at the requests before draining. a producer publishes before
+    // it asks, so everything a request we've seen covers is in the ring
+    // by now. read after draining, a request could come with a message
+    // that just missed the drain.
+    int requested = __atomic_load_n(&sync_requested, __ATOMIC_ACQUIRE);
+    while (drain());
+
+    if (requested != synced) {
+      synced = requested;
+      uint64_t one = 1;
+      ssize_t r = write(synced_fd, &one, sizeof(one));
+      (void)r;
+    }
+
+    // announce we're going to sleep, then look again in case something
+    // arrived in between.
+    __atomic_store_n(&writer_sleeping, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&head, __ATOMIC_SEQ_CST) != tail ||
+        __atomic_load_n(&sync_requested, __ATOMIC_SEQ_CST) != synced) {
+      __atomic_store_n(&writer_sleeping, 0, __ATOMIC_SEQ_CST);
+      continue;
+    }
+    uint64_t v;
+    ssize_t r = read(wake_fd, &v, sizeof(v));
+    (void)r;
+  }
+  return NULL;
+}
+
+void log_init() {
+  wake_fd = eventfd(0, EFD_CLOEXEC);
+  synced_fd = eventfd(0, EFD_CLOEXEC);
+  pthread_t thread;
+  if (wake_fd < 0 || synced_fd < 0 ||
+      pthread_create(&thread, NULL, writer, NULL)) {
+    fprintf(stderr, "could not start log writer\n");
+    exit(1);
+  }
+  pthread_detach(thread);
+  started = 1;
+}
+
+void log_sync() {
+  if (!started) {
+    // nobody to wait for, so write it ourselves
+    drain();
+    return;
+  }
+  __atomic_add_fetch(&sync_requested, 1, __ATOMIC_SEQ_CST);
+  wake_writer();
+  uint64_t v;
+  ssize_t r = read(synced_fd, &v, sizeof(v));
+  (void)r;
+}
+
+// claim the next slot, or return NULL if the ring is full.
+static Entry* claim() {
+  unsigned long t = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+  if (head - t >= RING_SLOTS) {
+    return NULL;
+  }
+  return &ring[head % RING_SLOTS];
+}
+
+static void publish() {
+  __atomic_store_n(&head, head + 1, __ATOMIC_RELEASE);
+  wake_writer();
+}
+
+void log_msg(char level, const char* fn, char* msg, ...) {
+  if (dropped) {
+    Entry* e = claim();
+    if (!e) {
+      dropped++;
+      return;
+    }
+    clock_gettime(CLOCK_REALTIME, &e->ts);
+    e->fn = __func__;
+    snprintf(e->msg, MSG_LEN, "dropped %lu messages", dropped);
+    dropped = 0;
+    publish();
+  }
+
+  Entry* e = claim();
+  if (!e) {
+    dropped++;
+    return;
+  }
+
+  clock_gettime(CLOCK_REALTIME, &e->ts);
+  e->fn = fn;
+  va_list args;
+  va_start(args, msg);
+  vsnprintf(e->msg, MSG_LEN, msg, args);
+  va_end(args);
+  publish();
+}
@@ -0,0 +1,43 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdlib.h>
+
+// Asynchronous logging.
+//
+// log_msg formats only the message itself into a slot in a lock-free ring
+// buffer and returns. A background thread adds timestamps and writes
+// whatever has accumulated to stdout in one go, so the caller never
+// blocks on the terminal or a log file. If the ring is full, messages are
+// dropped and the number dropped is reported once there is room again.
+//
+// Messages below LOG_LEVEL are removed at compile time.
+
+#define LEVEL_WARN 2
+#define LEVEL_INFO 1
+#define LEVEL_FINE 0
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LEVEL_INFO
+#endif
+
+// start the writer thread. messages logged before this are queued.
+void log_init();
+
+// write out everything queued so far, and wait until it's written.
+void log_sync();
+
+void log_msg(char level, const char* fn, char* msg, ...);
+
+// level and LOG_LEVEL are both constants, so below LOG_LEVEL the condition
+// is always false and the compiler drops the call. the arguments are still
+// type-checked and count as used, so nothing warns.
+#define LOG_AT(level, ...) \
+  if (level >= LOG_LEVEL) log_msg(level, __func__, __VA_ARGS__)
+
+#define FATAL(...) { LOG_AT(LEVEL_WARN, __VA_ARGS__); log_sync(); exit(1); }
+#define WARN(...) LOG_AT(LEVEL_WARN, __VA_ARGS__);
+#define INFO(...) LOG_AT(LEVEL_INFO, __VA_ARGS__);
+#define FINE(...) LOG_AT(LEVEL_FINE, __VA_ARGS__);
+
+#endif
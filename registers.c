@@ -0,0 +1,78 @@
+#include "registers.h"
+#include <assert.h>
+#include <stdlib.h>
+
+typedef struct {
+  RegisterEntry* entries;
+  unsigned int capacity;
+  unsigned int length;
+} Register;
+
+static Register registers[REGISTERS];
+
+static int16_t clamp16(int v) {
+  return v < INT16_MIN ? INT16_MIN : v > INT16_MAX ? INT16_MAX : v;
+}
+
+static uint16_t clampu16(int v) {
+  return v < 0 ? 0 : v > UINT16_MAX ? UINT16_MAX : v;
+}
+
+void registers_free() {
+  for (unsigned int r = 0; r < REGISTERS; r++) {
+    free(registers[r].entries);
+    registers[r].entries = NULL;
+    registers[r].capacity = 0;
+    registers[r].length = 0;
+  }
+}
+
+void register_clear(unsigned int r) {
+  assert(r < REGISTERS);
+  registers[r].length = 0;
+}
+
+void register_append(unsigned int r, const Configuration *conf) {
+  assert(r < REGISTERS);
+  Register *reg = &registers[r];
+  if (reg->length == reg->capacity) {
+    reg->capacity = reg->capacity ? reg->capacity * 2 : 16;
+    reg->entries = realloc(reg->entries, sizeof(RegisterEntry) * reg->capacity);
+    assert(reg->entries);
+  }
+
+  RegisterEntry *e = &reg->entries[reg->length++];
+  e->win = conf->win;
+  e->x = clamp16(conf->bounds.x);
+  e->y = clamp16(conf->bounds.y);
+  e->w = clampu16(conf->bounds.w);
+  e->h = clampu16(conf->bounds.h);
+  e->orig_x = clamp16(conf->orig_bounds.x);
+  e->orig_y = clamp16(conf->orig_bounds.y);
+  e->orig_w = clampu16(conf->orig_bounds.w);
+  e->orig_h = clampu16(conf->orig_bounds.h);
+  e->max_state = conf->max_state;
+  e->border_width = conf->border_width;
+}
+
+unsigned int register_length(unsigned int r) {
+  assert(r < REGISTERS);
+  return registers[r].length;
+}
+
+void register_get(unsigned int r, unsigned int i, Configuration *conf) {
+  assert(r < REGISTERS);
+  assert(i < registers[r].length);
+  RegisterEntry *e = &registers[r].entries[i];
+  conf->win = e->win;
+  conf->bounds.x = e->x;
+  conf->bounds.y = e->y;
+  conf->bounds.w = e->w;
+  conf->bounds.h = e->h;
+  conf->orig_bounds.x = e->orig_x;
+  conf->orig_bounds.y = e->orig_y;
+  conf->orig_bounds.w = e->orig_w;
+  conf->orig_bounds.h = e->orig_h;
+  conf->max_state = e->max_state;
+  conf->border_width = e->border_width;
+}
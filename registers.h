@@ -0,0 +1,52 @@
+#ifndef REGISTERS_H
+#define REGISTERS_H
+
+#include "client.h"
+#include <X11/Xlib.h>
+#include <stdint.h>
+
+// Numbered registers holding window configurations.
+//
+// A register is a list of windows with the geometry, maximization state
+// and border each had when it was saved, most recently focused first.
+// Entries are stored packed at the widths X itself uses for geometry,
+// so a register of dozens of windows fits in a few cache lines.
+
+#define REGISTERS 9
+
+// one window's configuration as stored
+typedef struct __attribute__((packed)) {
+  uint32_t win;
+  int16_t x, y;
+  uint16_t w, h;
+  // bounds before maximization
+  int16_t orig_x, orig_y;
+  uint16_t orig_w, orig_h;
+  uint8_t max_state;
+  uint8_t border_width;
+} RegisterEntry;
+
+// and unpacked
+typedef struct {
+  Window win;
+  Rectangle bounds;
+  Rectangle orig_bounds;
+  char max_state;
+  char border_width;
+} Configuration;
+
+void registers_free();
+
+// empty register r, ready for saving into
+void register_clear(unsigned int r);
+
+// append a window's configuration to register r. values are clamped to
+// what X can represent.
+void register_append(unsigned int r, const Configuration *conf);
+
+unsigned int register_length(unsigned int r);
+
+// the i'th configuration in register r
+void register_get(unsigned int r, unsigned int i, Configuration *conf);
+
+#endif
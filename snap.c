@@ -1,6 +1,11 @@
 #include "snap.h"
+#include <assert.h>
 #include <stdlib.h>
 
+#ifdef SNAP_SIMD
+#include <immintrin.h>
+#endif
+
 int snap(int x, int* xs, unsigned int n, unsigned int dist) {
   unsigned int d = dist;
   int r = x;
@@ -14,3 +19,196 @@ int snap(int x, int* xs, unsigned int n, unsigned int dist) {
   }
   return r;
 }
+
+void snap_grid_init(struct SnapGrid *sg, int extent, unsigned int cell_size) {
+  assert(cell_size > 0);
+  sg->cell_size = cell_size;
+  sg->count = extent > 0 ? (extent + cell_size - 1) / cell_size : 1;
+  sg->length = 0;
+  sg->cells = calloc(sg->count, sizeof(struct SnapCell));
+  assert(sg->cells);
+}
+
+void snap_grid_free(struct SnapGrid *sg) {
+  for (unsigned int i = 0; i < sg->count; i++) {
+    free(sg->cells[i].values);
+    free(sg->cells[i].owners);
+  }
+  free(sg->cells);
+  sg->cells = NULL;
+  sg->count = 0;
+  sg->length = 0;
+}
+
+// the cell a value belongs in
+static unsigned int cell_of(struct SnapGrid *sg, int value) {
+  if (value < 0) {
+    return 0;
+  }
+  unsigned int c = value / sg->cell_size;
+  return c < sg->count ? c : sg->count - 1;
+}
+
+void snap_grid_add(struct SnapGrid *sg, int value, unsigned long owner) {
+  assert(owner < SNAP_NO_OWNER);
+  struct SnapCell *cell = &sg->cells[cell_of(sg, value)];
+  if (cell->length == cell->capacity) {
+    cell->capacity = cell->capacity ? cell->capacity * 2 : 4;
+    cell->values = realloc(cell->values, sizeof(int) * cell->capacity);
+    cell->owners = realloc(cell->owners, sizeof(uint32_t) * cell->capacity);
+    assert(cell->values && cell->owners);
+  }
+  cell->values[cell->length] = value;
+  cell->owners[cell->length] = owner;
+  cell->length++;
+  sg->length++;
+}
+
+void snap_grid_remove(struct SnapGrid *sg, int value, unsigned long owner) {
+  struct SnapCell *cell = &sg->cells[cell_of(sg, value)];
+  for (unsigned int i = 0; i < cell->length; i++) {
+    if (cell->values[i] == value && cell->owners[i] == owner) {
+      cell->length--;
+      cell->values[i] = cell->values[cell->length];
+      cell->owners[i] = cell->owners[cell->length];
+      sg->length--;
+      return;
+    }
+  }
+}
+
+// The scans rank each candidate by a key: twice its distance from x, plus
+// one if it's above x. The smallest key is the nearest value, and of two
+// equally near the lower one, as the query wants. Skipped values, and any
+// dist or further away, get SNAP_NO_KEY. Keys fit since dist < 2^31.
+
+unsigned int snap_cell_scan_scalar(const struct SnapCell *cell, int x,
+                                   unsigned int dist, uint32_t skip) {
+  unsigned int best = SNAP_NO_KEY;
+  for (unsigned int i = 0; i < cell->length; i++) {
+    unsigned int dd = abs(cell->values[i] - x);
+    if (dd < dist && cell->owners[i] != skip) {
+      unsigned int key = dd << 1 | (cell->values[i] > x);
+      if (key < best) {
+        best = key;
+      }
+    }
+  }
+  return best;
+}
+
+#ifdef SNAP_SIMD
+
+__attribute__((target("sse4.1")))
+unsigned int snap_cell_scan_sse41(const struct SnapCell *cell, int x,
+                                  unsigned int dist, uint32_t skip) {
+  __m128i vx = _mm_set1_epi32(x);
+  __m128i vlast = _mm_set1_epi32(dist - 1);
+  __m128i vskip = _mm_set1_epi32(skip);
+  __m128i one = _mm_set1_epi32(1);
+  __m128i best = _mm_set1_epi32(SNAP_NO_KEY);
+  unsigned int i = 0;
+  for (; i + 4 <= cell->length; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)&cell->values[i]);
+    __m128i o = _mm_loadu_si128((const __m128i*)&cell->owners[i]);
+    __m128i dd = _mm_abs_epi32(_mm_sub_epi32(v, vx));
+    // dd <= dist - 1, unsigned, and not skipped
+    __m128i near = _mm_cmpeq_epi32(_mm_min_epu32(dd, vlast), dd);
+    __m128i ok = _mm_andnot_si128(_mm_cmpeq_epi32(o, vskip), near);
+    __m128i key = _mm_or_si128(_mm_slli_epi32(dd, 1),
+                               _mm_and_si128(_mm_cmpgt_epi32(v, vx), one));
+    // not ok gives all ones, which is SNAP_NO_KEY
+    key = _mm_or_si128(key, _mm_xor_si128(ok, _mm_set1_epi32(-1)));
+    best = _mm_min_epu32(best, key);
+  }
+  best = _mm_min_epu32(best, _mm_shuffle_epi32(best, _MM_SHUFFLE(1, 0, 3, 2)));
+  best = _mm_min_epu32(best, _mm_shuffle_epi32(best, _MM_SHUFFLE(2, 3, 0, 1)));
+  unsigned int b = _mm_cvtsi128_si32(best);
+
+  struct SnapCell tail = {
+    cell->values + i, cell->owners + i, 0, cell->length - i
+  };
+  unsigned int t = snap_cell_scan_scalar(&tail, x, dist, skip);
+  return t < b ? t : b;
+}
+
+__attribute__((target("avx2")))
+unsigned int snap_cell_scan_avx2(const struct SnapCell *cell, int x,
+                                 unsigned int dist, uint32_t skip) {
+  __m256i vx = _mm256_set1_epi32(x);
+  __m256i vlast = _mm256_set1_epi32(dist - 1);
+  __m256i vskip = _mm256_set1_epi32(skip);
+  __m256i one = _mm256_set1_epi32(1);
+  __m256i best = _mm256_set1_epi32(SNAP_NO_KEY);
+  unsigned int i = 0;
+  for (; i + 8 <= cell->length; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)&cell->values[i]);
+    __m256i o = _mm256_loadu_si256((const __m256i*)&cell->owners[i]);
+    __m256i dd = _mm256_abs_epi32(_mm256_sub_epi32(v, vx));
+    __m256i near = _mm256_cmpeq_epi32(_mm256_min_epu32(dd, vlast), dd);
+    __m256i ok = _mm256_andnot_si256(_mm256_cmpeq_epi32(o, vskip), near);
+    __m256i key = _mm256_or_si256(_mm256_slli_epi32(dd, 1),
+                                  _mm256_and_si256(_mm256_cmpgt_epi32(v, vx), one));
+    key = _mm256_or_si256(key, _mm256_xor_si256(ok, _mm256_set1_epi32(-1)));
+    best = _mm256_min_epu32(best, key);
+  }
+  __m128i m = _mm_min_epu32(_mm256_castsi256_si128(best),
+                            _mm256_extracti128_si256(best, 1));
+  m = _mm_min_epu32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+  m = _mm_min_epu32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+  unsigned int b = _mm_cvtsi128_si32(m);
+
+  struct SnapCell tail = {
+    cell->values + i, cell->owners + i, 0, cell->length - i
+  };
+  unsigned int t = snap_cell_scan_scalar(&tail, x, dist, skip);
+  return t < b ? t : b;
+}
+
+#endif
+
+static unsigned int scan_resolve(const struct SnapCell *cell, int x,
+                                 unsigned int dist, uint32_t skip);
+
+static SnapCellScan scan_impl = scan_resolve;
+
+// pick the widest scan this cpu supports on first use
+static unsigned int scan_resolve(const struct SnapCell *cell, int x,
+                                 unsigned int dist, uint32_t skip) {
+  scan_impl = snap_cell_scan_scalar;
+#ifdef SNAP_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    scan_impl = snap_cell_scan_avx2;
+  } else if (__builtin_cpu_supports("sse4.1")) {
+    scan_impl = snap_cell_scan_sse41;
+  }
+#endif
+  return scan_impl(cell, x, dist, skip);
+}
+
+int snap_grid_query(struct SnapGrid *sg, int x, unsigned int dist,
+                    unsigned long skip) {
+  if (!dist) {
+    return x;
+  }
+  uint32_t s = skip < SNAP_NO_OWNER ? skip : SNAP_NO_OWNER;
+
+  // only values strictly closer than dist count, so these cells hold
+  // every candidate
+  unsigned int from = cell_of(sg, x - (int)dist);
+  unsigned int to = cell_of(sg, x + (int)dist);
+
+  unsigned int best = SNAP_NO_KEY;
+  for (unsigned int c = from; c <= to; c++) {
+    unsigned int key = scan_impl(&sg->cells[c], x, dist, s);
+    if (key < best) {
+      best = key;
+    }
+  }
+  if (best == SNAP_NO_KEY) {
+    return x;
+  }
+  int dd = best >> 1;
+  return best & 1 ? x + dd : x - dd;
+}
@@ -1,8 +1,74 @@
 #ifndef snap_h
 #define snap_h
 
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SNAP_SIMD
+#endif
+
+// owners must be below this
+#define SNAP_NO_OWNER UINT32_MAX
+
 // Finds the value from XS (whose length is N) to which X should snap.
-// dist is the snap vicinity.
+// dist is the snap vicinity. This is the plain scan the grid below is
+// checked against.
 int snap(int x, int* xs, unsigned int n, unsigned int dist);
 
+// Snap values maintained as windows change rather than rebuilt for every
+// drag, bucketed into cells of a uniform grid over [0, extent). Values may
+// repeat, even for the same owner. With the cell size at least the snap
+// distance, a query only looks at the two or three cells around x, and
+// adding or removing a value only touches its own cell, however many
+// values there are elsewhere. Values outside the extent go in the first
+// or last cell.
+//
+// Cells keep values and owners in separate arrays so they can be scanned
+// with vector instructions. Owners are window ids, which fit in 32 bits.
+struct SnapCell {
+  int* values;
+  uint32_t* owners;
+  unsigned int capacity;
+  unsigned int length;
+};
+
+struct SnapGrid {
+  struct SnapCell* cells;
+  unsigned int count;
+  unsigned int cell_size;
+  unsigned int length;
+};
+
+void snap_grid_init(struct SnapGrid *sg, int extent, unsigned int cell_size);
+void snap_grid_free(struct SnapGrid *sg);
+
+// add a value belonging to owner
+void snap_grid_add(struct SnapGrid *sg, int value, unsigned long owner);
+
+// remove one occurrence of value belonging to owner, if there is one
+void snap_grid_remove(struct SnapGrid *sg, int value, unsigned long owner);
+
+// like snap(), over all values except those belonging to skip. when two
+// values are equally close the lower one wins.
+int snap_grid_query(struct SnapGrid *sg, int x, unsigned int dist,
+                    unsigned long skip);
+
+// Scans of one cell for snap_grid_query, which uses the widest the cpu
+// supports. Each returns the best candidate's key (see snap.c), or
+// SNAP_NO_KEY if there is none. They all give identical results. Only
+// call the vector ones if the cpu supports them, and only with dist > 0.
+#define SNAP_NO_KEY UINT32_MAX
+
+typedef unsigned int (*SnapCellScan)(const struct SnapCell *cell, int x,
+                                     unsigned int dist, uint32_t skip);
+
+unsigned int snap_cell_scan_scalar(const struct SnapCell *cell, int x,
+                                   unsigned int dist, uint32_t skip);
+#ifdef SNAP_SIMD
+unsigned int snap_cell_scan_sse41(const struct SnapCell *cell, int x,
+                                  unsigned int dist, uint32_t skip);
+unsigned int snap_cell_scan_avx2(const struct SnapCell *cell, int x,
+                                 unsigned int dist, uint32_t skip);
+#endif
+
 #endif
@@ -0,0 +1,216 @@
+#include "switcher.h"
+#include "clients.h"
+#include "log.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SWITCHER_WIDTH 600
+
+// space between rows, in pixels
+#define ROW_PAD 4
+
+// longest title drawn, in bytes
+#define ROW_TEXT 128
+
+// what a row of the pixmap currently shows
+typedef struct {
+  Window win;
+  char highlight;
+  char text[ROW_TEXT];
+} Row;
+
+static Display *dsp;
+static Window root;
+
+// kept from the first open until we exit
+static XFontStruct *font = NULL;
+static GC gc;
+static int row_height;
+
+// only while open
+static Window win = None;
+static Pixmap pixmap = None;
+static unsigned int pixmap_rows;
+
+// rows[0, rows_valid) describe what's drawn in the pixmap
+static Row *rows = NULL;
+static unsigned int rows_cap;
+static unsigned int rows_valid;
+
+// number of rows the window is sized for
+static unsigned int rows_sized;
+
+void switcher_init(Display *d, Window r) {
+  dsp = d;
+  root = r;
+}
+
+char switcher_is_open() {
+  return win != None;
+}
+
+Window switcher_window() {
+  return win;
+}
+
+static void fill_rows(unsigned int from, unsigned int to, unsigned long pixel) {
+  XSetForeground(dsp, gc, pixel);
+  XFillRectangle(dsp, pixmap, gc, 0, from * row_height,
+                 SWITCHER_WIDTH, (to - from) * row_height);
+}
+
+// make room for n rows in the pixmap. anything drawn is lost if it has to
+// grow.
+static void reserve_rows(unsigned int n) {
+  if (n > rows_cap) {
+    unsigned int cap = rows_cap ? rows_cap : 16;
+    while (cap < n) {
+      cap *= 2;
+    }
+    rows = realloc(rows, sizeof(Row) * cap);
+    assert(rows);
+    rows_cap = cap;
+  }
+
+  if (pixmap != None && n <= pixmap_rows) {
+    return;
+  }
+  if (pixmap != None) {
+    XFreePixmap(dsp, pixmap);
+  }
+  pixmap_rows = rows_cap;
+  pixmap = XCreatePixmap(dsp, win, SWITCHER_WIDTH, pixmap_rows * row_height,
+                         DefaultDepth(dsp, DefaultScreen(dsp)));
+  fill_rows(0, pixmap_rows, BlackPixel(dsp, DefaultScreen(dsp)));
+  rows_valid = 0;
+}
+
+static void switcher_open() {
+  if (!font) {
+    font = XLoadQueryFont(dsp, "fixed");
+    if (!font) {
+      WARN("could not load switcher font");
+      return;
+    }
+    row_height = font->ascent + font->descent + ROW_PAD;
+  }
+
+  win = XCreateSimpleWindow(dsp, root, 0, 0, SWITCHER_WIDTH, row_height,
+                            0, 0, BlackPixel(dsp, DefaultScreen(dsp)));
+  if (!win) {
+    WARN("failed to make window");
+    return;
+  }
+
+  XSetWindowAttributes attr;
+  attr.override_redirect = True;
+  attr.event_mask = ExposureMask;
+  XChangeWindowAttributes(dsp, win, CWOverrideRedirect | CWEventMask, &attr);
+
+  if (!gc) {
+    XGCValues vals;
+    vals.font = font->fid;
+    vals.graphics_exposures = False;
+    gc = XCreateGC(dsp, win, GCFont | GCGraphicsExposures, &vals);
+  }
+
+  rows_sized = 1;
+  reserve_rows(1);
+  XMapRaised(dsp, win);
+}
+
+static void switcher_close() {
+  XDestroyWindow(dsp, win);
+  XFreePixmap(dsp, pixmap);
+  win = None;
+  pixmap = None;
+  pixmap_rows = 0;
+  rows_valid = 0;
+}
+
+void switcher_toggle() {
+  if (win == None) {
+    switcher_open();
+  } else {
+    switcher_close();
+  }
+}
+
+static void draw_row(unsigned int i) {
+  Row *row = &rows[i];
+  int screen = DefaultScreen(dsp);
+  unsigned long bg = row->highlight ? WhitePixel(dsp, screen) : BlackPixel(dsp, screen);
+  unsigned long fg = row->highlight ? BlackPixel(dsp, screen) : WhitePixel(dsp, screen);
+  fill_rows(i, i + 1, bg);
+  XSetForeground(dsp, gc, fg);
+  XDrawString(dsp, pixmap, gc, ROW_PAD, i * row_height + ROW_PAD / 2 + font->ascent,
+              row->text, strlen(row->text));
+}
+
+void switcher_update(unsigned int highlight) {
+  if (win == None) {
+    return;
+  }
+
+  unsigned int n = window_history_length();
+  reserve_rows(n);
+
+  // the span of rows redrawn, to be copied to the window
+  unsigned int first = n;
+  unsigned int last = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    Window w = window_history_get(i);
+    Client *c = clients_find(w).data;
+    const char *text = c->name ? c->name : "???";
+    char hl = i == highlight;
+
+    Row *row = &rows[i];
+    if (i < rows_valid && row->win == w && row->highlight == hl &&
+        !strncmp(row->text, text, ROW_TEXT - 1)) {
+      continue;
+    }
+
+    row->win = w;
+    row->highlight = hl;
+    strncpy(row->text, text, ROW_TEXT - 1);
+    row->text[ROW_TEXT - 1] = '\0';
+    draw_row(i);
+    if (i < first) {
+      first = i;
+    }
+    last = i;
+  }
+  if (!n && rows_valid) {
+    // the window never gets smaller than a row, so blank it
+    fill_rows(0, 1, BlackPixel(dsp, DefaultScreen(dsp)));
+    first = 0;
+    last = 0;
+  }
+  rows_valid = n;
+
+  unsigned int sized = n ? n : 1;
+  unsigned int max_rows = DisplayHeight(dsp, DefaultScreen(dsp)) / row_height;
+  if (sized > max_rows) {
+    sized = max_rows;
+  }
+  if (sized != rows_sized) {
+    rows_sized = sized;
+    XResizeWindow(dsp, win, SWITCHER_WIDTH, sized * row_height);
+  }
+
+  if (first <= last) {
+    FINE("switcher redrew rows %d to %d of %d", first, last, n);
+    XCopyArea(dsp, pixmap, win, gc, 0, first * row_height,
+              SWITCHER_WIDTH, (last - first + 1) * row_height,
+              0, first * row_height);
+  }
+}
+
+void switcher_expose(XExposeEvent *event) {
+  if (win == None || event->window != win) {
+    return;
+  }
+  XCopyArea(dsp, pixmap, win, gc, event->x, event->y,
+            event->width, event->height, event->x, event->y);
+}
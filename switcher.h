@@ -0,0 +1,31 @@
+#ifndef SWITCHER_H
+#define SWITCHER_H
+
+#include <X11/Xlib.h>
+
+// A window listing the title of every client on the current workspace,
+// most recently focused first.
+//
+// Rows are drawn into an off-screen pixmap which is kept for as long as
+// the switcher is open, along with its font and GC. switcher_update only
+// redraws rows whose window, title or highlight have changed since they
+// were last drawn, and expose events are answered by copying from the
+// pixmap.
+
+void switcher_init(Display *dsp, Window root);
+
+// open it if it's closed, close it if it's open
+void switcher_toggle();
+
+char switcher_is_open();
+
+Window switcher_window();
+
+// bring the rows up to date with the focus history and titles. row
+// highlight is drawn as selected.
+void switcher_update(unsigned int highlight);
+
+// copy the exposed area back from the pixmap
+void switcher_expose(XExposeEvent *event);
+
+#endif
@@ -157,10 +157,87 @@ void send_to_back() {
   wb_free(&buf);
 }
 
+void grow_and_shrink() {
+  msg("grow_and_shrink");
+
+  struct WindowBuffer buf;
+  Window x;
+
+  wb_init(&buf, 2);
+
+  for (x = 0; x < 100; x++) {
+    wb_add(&buf, &x);
+  }
+  assert_int(100, buf.length);
+  assert_int(128, buf.capacity);
+  for (x = 0; x < 100; x++) {
+    assert_win(x, *wb_get(&buf, x));
+  }
+
+  // removing down to just over a quarter keeps the storage
+  while (buf.length > 33) {
+    wb_remove(&buf, buf.length - 1);
+  }
+  assert_int(128, buf.capacity);
+
+  // a quarter halves it
+  wb_remove(&buf, buf.length - 1);
+  assert_int(64, buf.capacity);
+
+  // adding one back doesn't immediately grow again
+  wb_add(&buf, &x);
+  assert_int(64, buf.capacity);
+
+  // never automatically shrink below the initial capacity
+  while (buf.length > 0) {
+    wb_remove(&buf, 0);
+  }
+  assert_int(2, buf.capacity);
+
+  wb_free(&buf);
+}
+
+void reserve_and_shrink_to_fit() {
+  msg("reserve_and_shrink_to_fit");
+
+  struct WindowBuffer buf;
+  Window x;
+
+  wb_init(&buf, 4);
+
+  wb_reserve(&buf, 1000);
+  assert_int(1000, buf.capacity);
+
+  // reserving less is a no-op
+  wb_reserve(&buf, 10);
+  assert_int(1000, buf.capacity);
+
+  x = 100;
+  wb_add(&buf, &x);
+  x = 200;
+  wb_add(&buf, &x);
+  x = 300;
+  wb_add(&buf, &x);
+
+  wb_shrink_to_fit(&buf);
+  assert_int(3, buf.capacity);
+  assert_wb_elements(&buf, 100, 200, 300);
+
+  // and it still grows from there
+  x = 400;
+  wb_add(&buf, &x);
+  assert_int(6, buf.capacity);
+  assert_wb_elements(&buf, 100, 200, 300, 400);
+
+  wb_free(&buf);
+}
+
 int main(int argc, char** argv) {
   basic();
   remove_last();
   bring_to_front();
   send_to_back();
+  grow_and_shrink();
+  reserve_and_shrink_to_fit();
   msg("success!");
 }
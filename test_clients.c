@@ -0,0 +1,324 @@
+#include "clients.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+void msg(char* str) {
+  printf("%s\n", str);
+}
+
+void assert_win(Window expected, Window actual) {
+  if (expected != actual) {
+    printf("expected %lx, but got %lx\n", expected, actual);
+    exit(1);
+  }
+}
+
+void assert_int(int expected, int actual) {
+  if (expected != actual) {
+    printf("expected %d, but got %d\n", expected, actual);
+    exit(1);
+  }
+}
+
+// adds a client whose bounds are derived from its window, so they can be
+// checked after it moves around
+void add(Window win) {
+  Client c = {0};
+  c.max_state = win / 100;
+  Rectangle bounds = { win, win + 1, win + 2, win + 3 };
+  clients_add(win, bounds, &c);
+}
+
+// the client for win still has the bounds and cold data add gave it
+void assert_parts(Window win) {
+  Client *c = clients_find(win).data;
+  assert_win(win, client_win(c));
+  assert_int(win / 100, c->max_state);
+  assert_int(win, client_bounds(c)->x);
+  assert_int(win + 3, client_bounds(c)->h);
+}
+
+// assert the focus history, most recent first. caller must specify same
+// number of windows as there are clients, as ints.
+void assert_history(unsigned int n, ...) {
+  assert_int(n, clients.length);
+  va_list args;
+  va_start(args, n);
+  for (unsigned int i = 0; i < n; i++) {
+    assert_win(va_arg(args, int), window_history_get(i));
+  }
+  va_end(args);
+
+  // and backwards, to check the links in the other direction
+  va_start(args, n);
+  Window expected[n];
+  for (unsigned int i = 0; i < n; i++) {
+    expected[i] = va_arg(args, int);
+  }
+  va_end(args);
+  for (unsigned int i = n; i > 0; i--) {
+    assert_win(expected[i - 1], window_history_get(i - 1));
+  }
+}
+
+void find() {
+  msg("find");
+  clients_init(2);
+
+  add(100);
+  add(200);
+  add(300);
+  assert_win(200, client_win(clients_find(200).data));
+  if (clients_find(400).data) {
+    msg("found a client which was never added");
+    exit(1);
+  }
+
+  // deleting the first client moves the last into its slot
+  clients_del(100);
+  assert_win(300, client_win(clients_find(300).data));
+  assert_int(0, clients_find(300).index);
+  assert_win(200, client_win(clients_find(200).data));
+  assert_parts(200);
+  assert_parts(300);
+
+  clients_free();
+}
+
+void focus_history() {
+  msg("focus_history");
+  clients_init(2);
+
+  add(100);
+  add(200);
+  add(300);
+  add(400);
+  assert_history(4, 100, 200, 300, 400);
+
+  clients_focus_raise(300);
+  assert_history(4, 300, 100, 200, 400);
+
+  clients_focus_raise(300);
+  assert_history(4, 300, 100, 200, 400);
+
+  clients_focus_raise(400);
+  assert_history(4, 400, 300, 100, 200);
+  assert_win(400, client_win(clients_most_recent().data));
+
+  clients_focus_lower(400);
+  assert_history(4, 300, 100, 200, 400);
+
+  clients_focus_lower(200);
+  assert_history(4, 300, 100, 400, 200);
+
+  // unknown windows are ignored
+  clients_focus_raise(999);
+  clients_focus_lower(999);
+  assert_history(4, 300, 100, 400, 200);
+
+  clients_free();
+}
+
+void delete_keeps_history() {
+  msg("delete_keeps_history");
+  clients_init(2);
+
+  add(100);
+  add(200);
+  add(300);
+  add(400);
+  add(500);
+  clients_focus_raise(500);
+  clients_focus_raise(200);
+  assert_history(5, 200, 500, 100, 300, 400);
+
+  // 500 is last in the buffer, so deleting 100 relocates it
+  clients_del(100);
+  assert_history(4, 200, 500, 300, 400);
+  assert_parts(500);
+
+  clients_del(200);
+  assert_history(3, 500, 300, 400);
+
+  clients_del(400);
+  assert_history(2, 500, 300);
+
+  clients_focus_raise(300);
+  assert_history(2, 300, 500);
+
+  clients_del(300);
+  clients_del(500);
+  assert_int(0, clients.length);
+
+  add(600);
+  assert_history(1, 600);
+
+  clients_free();
+}
+
+void names() {
+  msg("names");
+  clients_init(2);
+
+  add(100);
+  Client *c = clients_find(100).data;
+  if (c->name) {
+    msg("name set before any was given");
+    exit(1);
+  }
+
+  client_set_name(c, "hello", 5);
+  assert_int(0, strcmp("hello", c->name));
+  char *storage = c->name;
+
+  // shorter names reuse the storage, and needn't be terminated
+  client_set_name(c, "hi there", 2);
+  assert_int(0, strcmp("hi", c->name));
+  if (c->name != storage) {
+    msg("storage was not reused");
+    exit(1);
+  }
+
+  // longer ones grow it
+  char long_name[100];
+  memset(long_name, 'x', sizeof(long_name));
+  client_set_name(c, long_name, sizeof(long_name));
+  assert_int(sizeof(long_name), strlen(c->name));
+
+  // and the name stays with its client when clients move
+  add(200);
+  client_set_name(clients_find(200).data, "two", 3);
+  clients_del(100);
+  assert_int(0, strcmp("two", clients_find(200).data->name));
+
+  clients_free();
+}
+
+// a client on workspace ws
+void add_to(Window win, unsigned int ws) {
+  Client c = {0};
+  c.workspace = ws;
+  Rectangle bounds = {0};
+  clients_add(win, bounds, &c);
+}
+
+// like assert_history, but for the current workspace
+void assert_ws_history(unsigned int n, ...) {
+  assert_int(n, window_history_length());
+  va_list args;
+  va_start(args, n);
+  for (unsigned int i = 0; i < n; i++) {
+    assert_win(va_arg(args, int), window_history_get(i));
+  }
+  va_end(args);
+  assert_win(None, window_history_get(n));
+}
+
+void workspaces() {
+  msg("workspaces");
+  clients_init(2);
+
+  add_to(100, 0);
+  add_to(200, 1);
+  add_to(300, 0);
+  add_to(400, 1);
+  assert_int(0, clients_workspace());
+  assert_ws_history(2, 100, 300);
+  assert_int(2, clients_workspace_length(1));
+
+  clients_set_workspace(1);
+  assert_ws_history(2, 200, 400);
+  clients_focus_raise(400);
+  assert_ws_history(2, 400, 200);
+
+  // moving goes to the front of the other workspace
+  clients_move_to_workspace(300, 1);
+  assert_ws_history(3, 300, 400, 200);
+  assert_int(1, clients_workspace_length(0));
+
+  // deleting 100 moves a client from workspace 1 into its slot
+  clients_del(100);
+  assert_ws_history(3, 300, 400, 200);
+  clients_set_workspace(0);
+  assert_ws_history(0);
+  clients_set_workspace(2);
+  assert_ws_history(0);
+
+  clients_set_workspace(1);
+  clients_del(400);
+  assert_ws_history(2, 300, 200);
+
+  clients_free();
+}
+
+// assert the stacking order, top first, walking it both ways
+void assert_stack(unsigned int n, ...) {
+  va_list args;
+  va_start(args, n);
+  Window expected[n];
+  for (unsigned int i = 0; i < n; i++) {
+    expected[i] = va_arg(args, int);
+  }
+  va_end(args);
+
+  Window win = clients_stack_top();
+  for (unsigned int i = 0; i < n; i++) {
+    assert_win(expected[i], win);
+    win = clients_stack_below(win);
+  }
+  assert_win(None, win);
+
+  win = clients_stack_bottom();
+  for (unsigned int i = n; i > 0; i--) {
+    assert_win(expected[i - 1], win);
+    win = clients_stack_above(win);
+  }
+  assert_win(None, win);
+}
+
+void stacking() {
+  msg("stacking");
+  clients_init(2);
+  assert_stack(0);
+
+  // new clients go on top, whatever their workspace
+  add_to(100, 0);
+  add_to(200, 1);
+  add_to(300, 0);
+  add_to(400, 0);
+  assert_stack(4, 400, 300, 200, 100);
+
+  assert_int(1, clients_stack_raise(100));
+  assert_int(0, clients_stack_raise(100));
+  assert_stack(4, 100, 400, 300, 200);
+
+  assert_int(1, clients_stack_lower(400));
+  assert_int(0, clients_stack_lower(400));
+  assert_stack(4, 100, 300, 200, 400);
+  assert_int(0, clients_stack_raise(999));
+
+  // 400 is last in the buffer, so deleting 100 relocates it
+  clients_del(100);
+  assert_stack(3, 300, 200, 400);
+  clients_stack_raise(400);
+  assert_stack(3, 400, 300, 200);
+
+  clients_del(400);
+  clients_del(200);
+  assert_stack(1, 300);
+  clients_del(300);
+  assert_stack(0);
+
+  clients_free();
+}
+
+int main(int argc, char** argv) {
+  find();
+  focus_history();
+  delete_keeps_history();
+  names();
+  workspaces();
+  stacking();
+  msg("success!");
+}
@@ -0,0 +1,71 @@
+#include "hist.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+void msg(char* str) {
+  printf("%s\n", str);
+}
+
+void assert_int(long long expected, long long actual) {
+  if (expected != actual) {
+    printf("expected %lld, but got %lld\n", expected, actual);
+    exit(1);
+  }
+}
+
+// assert actual is within the histogram's resolution of expected
+void assert_close(unsigned long long expected, unsigned long long actual) {
+  unsigned long long err = expected / HIST_SUB;
+  if (actual + err < expected || actual > expected + err) {
+    printf("expected about %llu, but got %llu\n", expected, actual);
+    exit(1);
+  }
+}
+
+void small_values() {
+  msg("small_values");
+  Histogram *h = calloc(1, sizeof(Histogram));
+
+  assert_int(0, hist_percentile(h, 0.5));
+
+  for (unsigned int v = 1; v <= 10; v++) {
+    hist_record(h, v);
+  }
+  assert_int(10, h->total);
+  assert_int(10, h->max);
+  assert_int(5, hist_percentile(h, 0.5));
+  assert_int(10, hist_percentile(h, 1.0));
+  assert_int(1, hist_percentile(h, 0.0));
+
+  free(h);
+}
+
+void large_values() {
+  msg("large_values");
+  Histogram *h = calloc(1, sizeof(Histogram));
+
+  // 1..100000 once each
+  for (unsigned long long v = 1; v <= 100000; v++) {
+    hist_record(h, v);
+  }
+  assert_close(50000, hist_percentile(h, 0.5));
+  assert_close(99000, hist_percentile(h, 0.99));
+  assert_close(99900, hist_percentile(h, 0.999));
+  assert_int(100000, hist_percentile(h, 1.0));
+
+  // the extremes of the range have buckets too
+  hist_record(h, ~0ULL);
+  assert_int(~0ULL, h->max);
+  assert_int(~0ULL, hist_percentile(h, 1.0));
+
+  hist_reset(h);
+  assert_int(0, h->total);
+
+  free(h);
+}
+
+int main(int argc, char** argv) {
+  small_values();
+  large_values();
+  msg("success!");
+}
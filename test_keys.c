@@ -0,0 +1,194 @@
+#include "keys.h"
+#include "timers.h"
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <X11/keysym.h>
+
+#define SEQ_US 2000
+#define HOLD_US 2000
+
+void msg(char* str) {
+  printf("%s\n", str);
+}
+
+void assert_int(int expected, int actual) {
+  if (expected != actual) {
+    printf("expected %d, but got %d\n", expected, actual);
+    exit(1);
+  }
+}
+
+// records which bindings ran, in order
+char ran[16];
+unsigned int ran_count = 0;
+
+void run_a() { ran[ran_count++] = 'a'; }
+void run_b() { ran[ran_count++] = 'b'; }
+void run_c() { ran[ran_count++] = 'c'; }
+void run_h() { ran[ran_count++] = 'h'; }
+
+// how deep in grabs we are
+int grabbed = 0;
+
+void grab(char on) {
+  grabbed += on ? 1 : -1;
+}
+
+// keycodes are the keysym plus one, so a different mapping can be tried
+// by changing the offset
+unsigned int offset = 1;
+
+KeyCode to_keycode(KeySym sym) {
+  return (sym + offset) & 0xff;
+}
+
+KeyCode kc(KeySym sym) {
+  return to_keycode(sym);
+}
+
+void reset() {
+  ran_count = 0;
+}
+
+// wait for whatever timers are due
+void wait_timers(int tfd) {
+  struct pollfd p = { .fd = tfd, .events = POLLIN };
+  poll(&p, 1, 100);
+  timers_run();
+}
+
+KeyBinding bindings[] = {
+  { { { XK_a, Mod4Mask } }, run_a, NULL },
+  // b alone, and b then c
+  { { { XK_b, Mod4Mask } }, run_b, NULL },
+  { { { XK_b, Mod4Mask }, { XK_c, 0 } }, run_c, NULL },
+  // a sequence which has no binding of its own
+  { { { XK_x, Mod4Mask }, { XK_y, 0 }, { XK_z, 0 } }, run_a, NULL },
+  // tap or hold
+  { { { XK_h, Mod4Mask } }, run_a, run_h },
+};
+
+#define BINDINGS (sizeof(bindings) / sizeof(KeyBinding))
+
+void single() {
+  msg("single");
+  reset();
+
+  assert_int(1, keys_press(kc(XK_a), Mod4Mask));
+  assert_int(1, ran_count);
+  assert_int('a', ran[0]);
+
+  // modifiers must match, except for lock and num-lock
+  assert_int(0, keys_press(kc(XK_a), 0));
+  assert_int(0, keys_press(kc(XK_a), Mod4Mask | ShiftMask));
+  assert_int(1, keys_press(kc(XK_a), Mod4Mask | LockMask | Mod2Mask));
+  assert_int(2, ran_count);
+  assert_int(0, grabbed);
+}
+
+void sequence(int tfd) {
+  msg("sequence");
+  reset();
+
+  assert_int(1, keys_press(kc(XK_x), Mod4Mask));
+  assert_int(1, grabbed);
+  assert_int(1, keys_press(kc(XK_y), 0));
+  assert_int(0, ran_count);
+  assert_int(1, keys_press(kc(XK_z), 0));
+  assert_int(1, ran_count);
+  assert_int('a', ran[0]);
+  assert_int(0, grabbed);
+
+  // b then c runs c only
+  reset();
+  keys_press(kc(XK_b), Mod4Mask);
+  keys_press(kc(XK_c), 0);
+  assert_int(1, ran_count);
+  assert_int('c', ran[0]);
+  assert_int(0, grabbed);
+
+  // b on its own runs once the sequence times out
+  reset();
+  keys_press(kc(XK_b), Mod4Mask);
+  assert_int(0, ran_count);
+  wait_timers(tfd);
+  assert_int(1, ran_count);
+  assert_int('b', ran[0]);
+  assert_int(0, grabbed);
+
+  // an unrelated key abandons the sequence and is looked up afresh
+  reset();
+  keys_press(kc(XK_x), Mod4Mask);
+  assert_int(1, keys_press(kc(XK_a), Mod4Mask));
+  assert_int(1, ran_count);
+  assert_int('a', ran[0]);
+  assert_int(0, grabbed);
+  assert_int(1, keys_press(kc(XK_x), Mod4Mask));
+  assert_int(0, keys_press(kc(XK_q), 0));
+  assert_int(0, grabbed);
+}
+
+void hold(int tfd) {
+  msg("hold");
+  reset();
+
+  // released quickly
+  keys_press(kc(XK_h), Mod4Mask);
+  assert_int(0, ran_count);
+  keys_release(kc(XK_h));
+  assert_int(1, ran_count);
+  assert_int('a', ran[0]);
+
+  // held
+  reset();
+  keys_press(kc(XK_h), Mod4Mask);
+  wait_timers(tfd);
+  assert_int(1, ran_count);
+  assert_int('h', ran[0]);
+  keys_release(kc(XK_h));
+  assert_int(1, ran_count);
+
+  // another key first counts as a tap
+  reset();
+  keys_press(kc(XK_h), Mod4Mask);
+  keys_press(kc(XK_a), Mod4Mask);
+  assert_int(2, ran_count);
+  assert_int('a', ran[0]);
+  assert_int('a', ran[1]);
+  assert_int(0, grabbed);
+}
+
+void rebuild() {
+  msg("rebuild");
+  reset();
+
+  // half way through a sequence when the mapping changes
+  keys_press(kc(XK_x), Mod4Mask);
+  offset = 2;
+  keys_build(bindings, BINDINGS, to_keycode);
+  assert_int(0, grabbed);
+
+  assert_int(1, keys_press(kc(XK_a), Mod4Mask));
+  assert_int(1, ran_count);
+  offset = 1;
+  assert_int(0, keys_press(kc(XK_a), Mod4Mask));
+}
+
+int main(int argc, char** argv) {
+  int tfd = timers_init();
+  if (tfd < 0) {
+    msg("no timerfd");
+    exit(1);
+  }
+  keys_init(grab, SEQ_US, HOLD_US);
+  keys_build(bindings, BINDINGS, to_keycode);
+
+  single();
+  sequence(tfd);
+  hold(tfd);
+  rebuild();
+
+  keys_free();
+  msg("success!");
+}
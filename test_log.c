@@ -0,0 +1,60 @@
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void assert_int(int expected, int actual) {
+  if (expected != actual) {
+    fprintf(stderr, "expected %d, but got %d\n", expected, actual);
+    exit(1);
+  }
+}
+
+// log lots of messages with the writer running, sync, and check they all
+// came out in order with timestamps and function names.
+int main(int argc, char** argv) {
+  FILE* out = tmpfile();
+  int saved = dup(STDOUT_FILENO);
+  dup2(fileno(out), STDOUT_FILENO);
+
+  log_init();
+  unsigned int n = 300;
+  for (unsigned int i = 0; i < n; i++) {
+    WARN("message %u", i);
+    if (i % 50 == 0) {
+      log_sync();
+    }
+  }
+  // compiled out, so never appears
+  FINE("fine message");
+  log_sync();
+
+  dup2(saved, STDOUT_FILENO);
+  rewind(out);
+
+  char line[512];
+  unsigned int count = 0;
+  unsigned int dropped = 0;
+  while (fgets(line, sizeof(line), out)) {
+    if (strstr(line, "dropped")) {
+      // the writer couldn't keep up. the remaining messages still come
+      // out in order, so skip ahead.
+      unsigned long d;
+      sscanf(strstr(line, "dropped"), "dropped %lu", &d);
+      dropped += d;
+      count += d;
+      continue;
+    }
+    char expected[64];
+    snprintf(expected, sizeof(expected), "main - message %u\n", count);
+    if (!strstr(line, expected)) {
+      fprintf(stderr, "unexpected line: %s", line);
+      exit(1);
+    }
+    count++;
+  }
+  assert_int(n, count);
+  printf("%u messages, %u dropped\n", n, dropped);
+  printf("success!\n");
+}
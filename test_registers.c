@@ -0,0 +1,95 @@
+#include "registers.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+void msg(char* str) {
+  printf("%s\n", str);
+}
+
+void assert_int(int expected, int actual) {
+  if (expected != actual) {
+    printf("expected %d, but got %d\n", expected, actual);
+    exit(1);
+  }
+}
+
+void assert_rect(Rectangle expected, Rectangle actual) {
+  assert_int(expected.x, actual.x);
+  assert_int(expected.y, actual.y);
+  assert_int(expected.w, actual.w);
+  assert_int(expected.h, actual.h);
+}
+
+void round_trip() {
+  msg("round_trip");
+  Configuration a = {
+    .win = 0x1e00004,
+    .bounds = { -20, 30, 800, 600 },
+    .orig_bounds = { 10, 10, 400, 300 },
+    .max_state = 2,
+    .border_width = 4,
+  };
+  Configuration b = {
+    .win = 0x2a00001,
+    .bounds = { 0, 0, 1, 1 },
+  };
+
+  register_append(3, &a);
+  register_append(3, &b);
+  assert_int(2, register_length(3));
+  assert_int(0, register_length(4));
+
+  Configuration out;
+  register_get(3, 0, &out);
+  assert_int(a.win, out.win);
+  assert_rect(a.bounds, out.bounds);
+  assert_rect(a.orig_bounds, out.orig_bounds);
+  assert_int(a.max_state, out.max_state);
+  assert_int(a.border_width, out.border_width);
+
+  register_get(3, 1, &out);
+  assert_int(b.win, out.win);
+  assert_rect(b.bounds, out.bounds);
+
+  register_clear(3);
+  assert_int(0, register_length(3));
+}
+
+void clamping() {
+  msg("clamping");
+  Configuration a = {
+    .win = 1,
+    .bounds = { -100000, 100000, -5, 100000 },
+  };
+  register_append(0, &a);
+  Configuration out;
+  register_get(0, 0, &out);
+  Rectangle expected = { -32768, 32767, 0, 65535 };
+  assert_rect(expected, out.bounds);
+}
+
+void growth() {
+  msg("growth");
+  for (unsigned int i = 0; i < 100; i++) {
+    Configuration a = { .win = i, .bounds = { i, i, i, i } };
+    register_append(8, &a);
+  }
+  assert_int(100, register_length(8));
+  for (unsigned int i = 0; i < 100; i++) {
+    Configuration out;
+    register_get(8, i, &out);
+    assert_int(i, out.win);
+    assert_int(i, out.bounds.h);
+  }
+}
+
+int main(int argc, char** argv) {
+  // small enough that dozens of windows fit in a few cache lines
+  assert_int(22, sizeof(RegisterEntry));
+
+  round_trip();
+  clamping();
+  growth();
+  registers_free();
+  msg("success!");
+}
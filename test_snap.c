@@ -12,6 +12,105 @@ void assert_int(int expected, int actual) {
   }
 }
 
+int compare_ints(const void *a, const void *b) {
+  int x = *(const int*)a;
+  int y = *(const int*)b;
+  return x < y ? -1 : x > y;
+}
+
+// add and remove values with random owners, then check queries against
+// snap over the sorted values of the owners which aren't skipped, whatever
+// the grid's cell size and however many values fall outside it.
+void grid() {
+  printf("grid\n");
+  srand(3);
+  for (unsigned int round = 0; round < 300; round++) {
+    unsigned int n = rand() % 100;
+    int range = 1 + rand() % 300;
+    int values[n ? n : 1];
+    unsigned long owners[n ? n : 1];
+    char present[n ? n : 1];
+
+    struct SnapGrid sg;
+    snap_grid_init(&sg, rand() % range, 1 + rand() % 40);
+    for (unsigned int i = 0; i < n; i++) {
+      values[i] = rand() % range - range / 2;
+      owners[i] = 1 + rand() % 8;
+      present[i] = 1;
+      snap_grid_add(&sg, values[i], owners[i]);
+    }
+    for (unsigned int i = 0; i < n; i++) {
+      if (rand() % 3 == 0) {
+        present[i] = 0;
+        snap_grid_remove(&sg, values[i], owners[i]);
+      }
+    }
+    // removing something which isn't there does nothing
+    snap_grid_remove(&sg, range, 99);
+
+    unsigned long skip = rand() % 9;
+    int xs[n ? n : 1];
+    unsigned int count = 0;
+    unsigned int total = 0;
+    for (unsigned int i = 0; i < n; i++) {
+      total += present[i];
+      if (present[i] && owners[i] != skip) {
+        xs[count++] = values[i];
+      }
+    }
+    assert_int(total, sg.length);
+    qsort(xs, count, sizeof(int), compare_ints);
+
+    for (int x = -range; x <= range; x++) {
+      unsigned int dist = rand() % 20;
+      int expected = snap(x, xs, count, dist);
+      int actual = snap_grid_query(&sg, x, dist, skip);
+      if (expected != actual) {
+        printf("round %u, x %d, dist %u: ", round, x, dist);
+        assert_int(expected, actual);
+      }
+    }
+    snap_grid_free(&sg);
+  }
+}
+
+// the vector scans agree with the scalar one, including on cells whose
+// length isn't a multiple of the vector width
+void kernels() {
+  printf("kernels\n");
+  srand(5);
+  SnapCellScan scans[2] = {0};
+#ifdef SNAP_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.1")) {
+    scans[0] = snap_cell_scan_sse41;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    scans[1] = snap_cell_scan_avx2;
+  }
+#endif
+  for (unsigned int round = 0; round < 1000; round++) {
+    unsigned int n = rand() % 40;
+    int range = 1 + rand() % 200;
+    int values[n ? n : 1];
+    uint32_t owners[n ? n : 1];
+    for (unsigned int i = 0; i < n; i++) {
+      values[i] = rand() % range - range / 2;
+      owners[i] = 1 + rand() % 4;
+    }
+    struct SnapCell cell = { values, owners, n, n };
+    int x = rand() % range - range / 2;
+    unsigned int dist = 1 + rand() % 30;
+    uint32_t skip = rand() % 5;
+    unsigned int expected = snap_cell_scan_scalar(&cell, x, dist, skip);
+    for (unsigned int k = 0; k < 2; k++) {
+      if (scans[k]) {
+        assert_int(expected, scans[k](&cell, x, dist, skip));
+      }
+    }
+  }
+}
+
 int main(int argc, char** argv) {
   int n = 5;
   int* xs = calloc(n, sizeof(int));
@@ -33,4 +132,14 @@ int main(int argc, char** argv) {
   // snap to closest
   assert_int(20, snap(19, xs, n, SNAP_DIST));
   assert_int(21, snap(21, xs, n, SNAP_DIST));
+
+  // equal distance either side: first in the list wins
+  assert_int(10, snap(15, xs, n, SNAP_DIST));
+  xs[0] = 20;
+  xs[1] = 10;
+  assert_int(20, snap(15, xs, n, SNAP_DIST));
+
+  grid();
+  kernels();
+  printf("success!\n");
 }
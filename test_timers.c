@@ -0,0 +1,124 @@
+#include "timers.h"
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void msg(char* str) {
+  printf("%s\n", str);
+}
+
+void assert_int(int expected, int actual) {
+  if (expected != actual) {
+    printf("expected %d, but got %d\n", expected, actual);
+    exit(1);
+  }
+}
+
+// records the order in which timers fire
+char fired[8];
+unsigned int fired_count = 0;
+
+void fire_a() { fired[fired_count++] = 'a'; }
+void fire_b() { fired[fired_count++] = 'b'; }
+void fire_c() { fired[fired_count++] = 'c'; }
+
+// wait up to timeout_ms for the timerfd to become readable. returns
+// whether it did.
+int wait_fd(int fd, int timeout_ms) {
+  struct pollfd p = { .fd = fd, .events = POLLIN };
+  return poll(&p, 1, timeout_ms) > 0;
+}
+
+void ordering() {
+  msg("ordering");
+  int fd = timers_init();
+  if (fd < 0) {
+    msg("no timerfd");
+    exit(1);
+  }
+
+  Timer a = { .fn = fire_a };
+  Timer b = { .fn = fire_b };
+  Timer c = { .fn = fire_c };
+  fired_count = 0;
+
+  timer_set(&a, 30000);
+  timer_set(&b, 10000);
+  timer_set(&c, 20000);
+  timer_cancel(&c);
+
+  // nothing is due yet
+  assert_int(0, wait_fd(fd, 0));
+
+  // b first
+  assert_int(1, wait_fd(fd, 1000));
+  timers_run();
+  assert_int(1, fired_count);
+  assert_int('b', fired[0]);
+
+  // rescheduling a pushes it back past where it was
+  long long t0 = timers_now_us();
+  timer_set(&a, 40000);
+  assert_int(1, wait_fd(fd, 1000));
+  timers_run();
+  assert_int(2, fired_count);
+  assert_int('a', fired[1]);
+  assert_int(1, timers_now_us() - t0 >= 40000);
+
+  // c was cancelled, so nothing else fires
+  assert_int(0, wait_fd(fd, 50));
+  assert_int(0, a.pending || b.pending || c.pending);
+}
+
+void same_time() {
+  msg("same_time");
+  timers_init();
+
+  Timer a = { .fn = fire_a };
+  Timer b = { .fn = fire_b };
+  fired_count = 0;
+
+  timer_set(&a, 0);
+  timer_set(&b, 0);
+  timers_run();
+  assert_int(2, fired_count);
+}
+
+void simulated() {
+  msg("simulated");
+  timers_init();
+
+  Timer a = { .fn = fire_a };
+  Timer b = { .fn = fire_b };
+  fired_count = 0;
+
+  timers_simulate(1000000);
+  timer_set(&a, 500);
+  timer_set(&b, 2000);
+  assert_int(1000000, timers_now_us());
+
+  timers_simulate(1000499);
+  timers_run();
+  assert_int(0, fired_count);
+
+  timers_simulate(1000500);
+  timers_run();
+  assert_int(1, fired_count);
+  assert_int('a', fired[0]);
+
+  timers_simulate(1005000);
+  timers_run();
+  assert_int(2, fired_count);
+  assert_int('b', fired[1]);
+
+  // back to the real clock
+  timers_init();
+  assert_int(1, timers_now_us() != 1005000);
+}
+
+int main(int argc, char** argv) {
+  ordering();
+  same_time();
+  simulated();
+  msg("success!");
+}
@@ -0,0 +1,71 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+void msg(char* str) {
+  printf("%s\n", str);
+}
+
+void assert_int(long long expected, long long actual) {
+  if (expected != actual) {
+    printf("expected %lld, but got %lld\n", expected, actual);
+    exit(1);
+  }
+}
+
+void record(long long t, int type, Window win) {
+  XEvent ev = {0};
+  ev.type = type;
+  ev.xany.window = win;
+  trace_record(t, &ev);
+}
+
+// record, reopen to append, then map and check everything's there
+int main(int argc, char** argv) {
+  msg("round_trip");
+
+  char path[] = "/tmp/test_trace_XXXXXX";
+  int fd = mkstemp(path);
+  close(fd);
+
+  assert_int(1, trace_open(path));
+  assert_int(1, trace_recording());
+  record(100, MapRequest, 0x10);
+  record(200, MotionNotify, 0x20);
+  trace_close();
+  assert_int(0, trace_recording());
+
+  assert_int(1, trace_open(path));
+  record(300, ConfigureNotify, 0x30);
+  trace_flush();
+  trace_close();
+
+  unsigned long count;
+  const TraceRecord *rs = trace_map(path, &count);
+  if (!rs) {
+    msg("failed to map trace");
+    exit(1);
+  }
+  assert_int(3, count);
+  assert_int(100, rs[0].t_ns);
+  assert_int(MapRequest, rs[0].event.type);
+  assert_int(0x10, rs[0].event.xany.window);
+  assert_int(MotionNotify, rs[1].event.type);
+  assert_int(300, rs[2].t_ns);
+  assert_int(0x30, rs[2].event.xany.window);
+  trace_unmap(rs, count);
+
+  // something which isn't a trace is rejected, both ways
+  FILE *f = fopen(path, "wb");
+  fputs("not a trace at all, just some text", f);
+  fclose(f);
+  if (trace_map(path, &count)) {
+    msg("mapped a file which isn't a trace");
+    exit(1);
+  }
+  assert_int(0, trace_open(path));
+
+  unlink(path);
+  msg("success!");
+}
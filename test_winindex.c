@@ -0,0 +1,102 @@
+#include "winindex.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+void msg(char* str) {
+  printf("%s\n", str);
+}
+
+void assert_int(int expected, int actual) {
+  if (expected != actual) {
+    printf("expected %d, but got %d\n", expected, actual);
+    exit(1);
+  }
+}
+
+// assert win maps to expected index
+void assert_found(struct WinIndex *wi, Window win, unsigned int expected) {
+  unsigned int actual;
+  if (!wi_get(wi, win, &actual)) {
+    printf("expected to find %lx\n", win);
+    exit(1);
+  }
+  assert_int(expected, actual);
+}
+
+void assert_missing(struct WinIndex *wi, Window win) {
+  unsigned int actual;
+  if (wi_get(wi, win, &actual)) {
+    printf("expected %lx to be missing, but found %d\n", win, actual);
+    exit(1);
+  }
+}
+
+void basic() {
+  msg("basic");
+
+  struct WinIndex wi;
+  wi_init(&wi, 4);
+
+  assert_missing(&wi, 0x100);
+
+  wi_put(&wi, 0x100, 0);
+  wi_put(&wi, 0x200, 1);
+  wi_put(&wi, 0x300, 2);
+  assert_int(3, wi.length);
+  assert_found(&wi, 0x100, 0);
+  assert_found(&wi, 0x200, 1);
+  assert_found(&wi, 0x300, 2);
+
+  // replace existing value
+  wi_put(&wi, 0x300, 7);
+  assert_int(3, wi.length);
+  assert_found(&wi, 0x300, 7);
+
+  wi_del(&wi, 0x200);
+  assert_int(2, wi.length);
+  assert_missing(&wi, 0x200);
+  assert_found(&wi, 0x100, 0);
+  assert_found(&wi, 0x300, 7);
+
+  // deleting something absent is fine
+  wi_del(&wi, 0x200);
+  assert_int(2, wi.length);
+
+  wi_free(&wi);
+}
+
+// grow well past the initial capacity, then delete every other entry to
+// exercise backward-shift deletion over long probe runs.
+void churn() {
+  msg("churn");
+
+  unsigned int n = 5000;
+  struct WinIndex wi;
+  wi_init(&wi, 1);
+
+  for (unsigned int i = 0; i < n; i++) {
+    wi_put(&wi, 0x400000 + i, i);
+  }
+  assert_int(n, wi.length);
+
+  for (unsigned int i = 0; i < n; i += 2) {
+    wi_del(&wi, 0x400000 + i);
+  }
+  assert_int(n / 2, wi.length);
+
+  for (unsigned int i = 0; i < n; i++) {
+    if (i % 2) {
+      assert_found(&wi, 0x400000 + i, i);
+    } else {
+      assert_missing(&wi, 0x400000 + i);
+    }
+  }
+
+  wi_free(&wi);
+}
+
+int main(int argc, char** argv) {
+  basic();
+  churn();
+  msg("success!");
+}
@@ -0,0 +1,105 @@
+#include "timers.h"
+#include <assert.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+static int tfd = -1;
+
+// pending timers, in no particular order
+static Timer* pending[MAX_TIMERS];
+static unsigned int pending_count = 0;
+
+// simulated time, or -1 to use the real clock
+static long long simulated_us = -1;
+
+int timers_init() {
+  tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  pending_count = 0;
+  simulated_us = -1;
+  return tfd;
+}
+
+long long timers_now_us() {
+  if (simulated_us >= 0) {
+    return simulated_us;
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// arm the timerfd for the earliest deadline, or disarm it if there are
+// none.
+static void rearm() {
+  struct itimerspec its = {0};
+  if (pending_count) {
+    long long earliest = pending[0]->deadline_us;
+    for (unsigned int i = 1; i < pending_count; i++) {
+      if (pending[i]->deadline_us < earliest) {
+        earliest = pending[i]->deadline_us;
+      }
+    }
+    // an all-zero it_value disarms, so never ask for time 0
+    if (earliest < 1) {
+      earliest = 1;
+    }
+    its.it_value.tv_sec = earliest / 1000000;
+    its.it_value.tv_nsec = (earliest % 1000000) * 1000;
+  }
+  timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void unlink_timer(Timer *t) {
+  for (unsigned int i = 0; i < pending_count; i++) {
+    if (pending[i] == t) {
+      pending[i] = pending[--pending_count];
+      break;
+    }
+  }
+  t->pending = 0;
+}
+
+void timers_simulate(long long now_us) {
+  simulated_us = now_us;
+}
+
+void timer_set(Timer *t, long long delay_us) {
+  assert(t->fn);
+  if (!t->pending) {
+    assert(pending_count < MAX_TIMERS);
+    pending[pending_count++] = t;
+    t->pending = 1;
+  }
+  t->deadline_us = timers_now_us() + delay_us;
+  rearm();
+}
+
+void timer_cancel(Timer *t) {
+  if (!t->pending) {
+    return;
+  }
+  unlink_timer(t);
+  rearm();
+}
+
+void timers_run() {
+  // clear readiness
+  uint64_t expirations;
+  while (read(tfd, &expirations, sizeof(expirations)) > 0);
+
+  long long now = timers_now_us();
+  for (unsigned int i = 0; i < pending_count;) {
+    Timer *t = pending[i];
+    if (t->deadline_us > now) {
+      i++;
+      continue;
+    }
+    unlink_timer(t);
+    // fn may set timers again, including this one. unlinking swapped a
+    // new timer into slot i, so look at it next.
+    t->fn();
+  }
+  rearm();
+}
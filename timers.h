@@ -0,0 +1,44 @@
+#ifndef TIMERS_H
+#define TIMERS_H
+
+// One-shot timers driven by a single timerfd.
+//
+// The timerfd is always armed for the earliest pending deadline, so an
+// event loop only needs to wait on it alongside its other fds and call
+// timers_run when it becomes readable.
+
+typedef void (*TimerFn)();
+
+typedef struct {
+  // absolute deadline in microseconds on the monotonic clock. only
+  // meaningful while the timer is pending.
+  long long deadline_us;
+  TimerFn fn;
+  char pending;
+} Timer;
+
+// maximum number of timers which may be pending at once
+#define MAX_TIMERS 8
+
+// create the timerfd. returns the fd to wait on, or -1 on failure.
+int timers_init();
+
+// microseconds on the monotonic clock, or the simulated time if one has
+// been set
+long long timers_now_us();
+
+// run timers off a simulated clock from now on, currently at now_us, as
+// when replaying a trace. timers_run fires whatever is due by it.
+void timers_simulate(long long now_us);
+
+// (re)schedule t to fire delay_us from now. its fn is called once.
+void timer_set(Timer *t, long long delay_us);
+
+// stop t from firing. fine to call on a timer which isn't pending.
+void timer_cancel(Timer *t);
+
+// call the fn of every timer whose deadline has passed, and re-arm the
+// timerfd for whatever is left.
+void timers_run();
+
+#endif
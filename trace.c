@@ -0,0 +1,109 @@
+#include "trace.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static FILE *out = NULL;
+
+static void make_header(TraceHeader *h) {
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  h->version = TRACE_VERSION;
+  h->record_size = sizeof(TraceRecord);
+}
+
+int trace_open(const char *path) {
+  out = fopen(path, "ab");
+  if (!out) {
+    return 0;
+  }
+
+  // a new file gets a header. an existing one must already have ours.
+  fseek(out, 0, SEEK_END);
+  if (ftell(out) == 0) {
+    TraceHeader h;
+    make_header(&h);
+    fwrite(&h, sizeof(h), 1, out);
+  } else {
+    TraceHeader expected, actual;
+    make_header(&expected);
+    FILE *in = fopen(path, "rb");
+    int ok = in && fread(&actual, sizeof(actual), 1, in) == 1 &&
+      !memcmp(&expected, &actual, sizeof(actual));
+    if (in) {
+      fclose(in);
+    }
+    if (!ok) {
+      fclose(out);
+      out = NULL;
+      return 0;
+    }
+  }
+
+  // big enough to hold a whole drain of motion in most cases
+  setvbuf(out, NULL, _IOFBF, sizeof(TraceRecord) * 256);
+  return 1;
+}
+
+void trace_record(long long t_ns, XEvent *event) {
+  TraceRecord r;
+  r.t_ns = t_ns;
+  r.event = *event;
+  fwrite(&r, sizeof(r), 1, out);
+}
+
+void trace_flush() {
+  if (out) {
+    fflush(out);
+  }
+}
+
+void trace_close() {
+  if (out) {
+    fclose(out);
+    out = NULL;
+  }
+}
+
+int trace_recording() {
+  return out != NULL;
+}
+
+const TraceRecord* trace_map(const char *path, unsigned long *count) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < sizeof(TraceHeader)) {
+    close(fd);
+    return NULL;
+  }
+
+  char *mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) {
+    return NULL;
+  }
+
+  TraceHeader expected;
+  make_header(&expected);
+  if (memcmp(mem, &expected, sizeof(expected))) {
+    munmap(mem, st.st_size);
+    return NULL;
+  }
+
+  madvise(mem, st.st_size, MADV_SEQUENTIAL);
+
+  // ignore a partial record at the end, from a crash mid-write
+  *count = (st.st_size - sizeof(TraceHeader)) / sizeof(TraceRecord);
+  return (const TraceRecord*)(mem + sizeof(TraceHeader));
+}
+
+void trace_unmap(const TraceRecord *records, unsigned long count) {
+  const char *mem = (const char*)records - sizeof(TraceHeader);
+  munmap((void*)mem, sizeof(TraceHeader) + count * sizeof(TraceRecord));
+}
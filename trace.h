@@ -0,0 +1,51 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <X11/Xlib.h>
+
+// Binary event traces.
+//
+// A trace is a header followed by fixed-size records, each an XEvent and
+// the monotonic time it was dispatched. Nothing needs parsing, so a trace
+// of any length can be mapped and walked as an array.
+//
+// Records hold raw XEvents, so traces are only readable on the same
+// architecture they were recorded on. The header records the sizes to
+// catch that.
+
+#define TRACE_MAGIC "WMTRACE"
+#define TRACE_VERSION 1
+
+typedef struct {
+  char magic[8];
+  unsigned int version;
+  unsigned int record_size;
+} TraceHeader;
+
+typedef struct {
+  long long t_ns;
+  XEvent event;
+} TraceRecord;
+
+// start appending to the trace at path, creating it if necessary. returns
+// 0 on failure.
+int trace_open(const char *path);
+
+// append an event. records are buffered until trace_flush.
+void trace_record(long long t_ns, XEvent *event);
+
+// write out any buffered records
+void trace_flush();
+
+void trace_close();
+
+// whether trace_open has been called successfully
+int trace_recording();
+
+// map the trace at path. returns the records and writes their number into
+// count, or returns NULL if the file isn't a readable trace.
+const TraceRecord* trace_map(const char *path, unsigned long *count);
+
+void trace_unmap(const TraceRecord *records, unsigned long count);
+
+#endif
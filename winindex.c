@@ -0,0 +1,118 @@
+#include "winindex.h"
+#include <assert.h>
+#include <stdlib.h>
+
+// keep load below 1/2 so probe sequences stay short
+#define MAX_LOAD_NUM 1
+#define MAX_LOAD_DEN 2
+
+static unsigned long hash(Window win) {
+  // fibonacci hashing. window ids are allocated sequentially from a client's
+  // resource base, so we need to spread the low bits around.
+  unsigned long long h = (unsigned long long)win * 11400714819323198485ull;
+  return (unsigned long)(h >> 32);
+}
+
+static void alloc_slots(struct WinIndex *wi, unsigned long capacity) {
+  wi->capacity = capacity;
+  wi->length = 0;
+  wi->slots = calloc(capacity, sizeof(WinIndexSlot));
+  assert(wi->slots);
+}
+
+void wi_init(struct WinIndex *wi, unsigned long n) {
+  unsigned long capacity = 8;
+  while (capacity * MAX_LOAD_NUM / MAX_LOAD_DEN < n) {
+    capacity *= 2;
+  }
+  alloc_slots(wi, capacity);
+}
+
+void wi_free(struct WinIndex *wi) {
+  free(wi->slots);
+  wi->slots = NULL;
+  wi->capacity = 0;
+  wi->length = 0;
+}
+
+static void grow(struct WinIndex *wi) {
+  WinIndexSlot* old = wi->slots;
+  unsigned long old_capacity = wi->capacity;
+  alloc_slots(wi, old_capacity * 2);
+  for (unsigned long i = 0; i < old_capacity; i++) {
+    if (old[i].win) {
+      wi_put(wi, old[i].win, old[i].index);
+    }
+  }
+  free(old);
+}
+
+void wi_put(struct WinIndex *wi, Window win, unsigned int index) {
+  assert(win);
+  if ((wi->length + 1) * MAX_LOAD_DEN > wi->capacity * MAX_LOAD_NUM) {
+    grow(wi);
+  }
+
+  unsigned long mask = wi->capacity - 1;
+  unsigned long i = hash(win) & mask;
+  while (wi->slots[i].win && wi->slots[i].win != win) {
+    i = (i + 1) & mask;
+  }
+  if (!wi->slots[i].win) {
+    wi->length++;
+  }
+  wi->slots[i].win = win;
+  wi->slots[i].index = index;
+}
+
+int wi_get(struct WinIndex *wi, Window win, unsigned int *index) {
+  if (!win || !wi->capacity) {
+    return 0;
+  }
+  unsigned long mask = wi->capacity - 1;
+  unsigned long i = hash(win) & mask;
+  while (wi->slots[i].win) {
+    if (wi->slots[i].win == win) {
+      *index = wi->slots[i].index;
+      return 1;
+    }
+    i = (i + 1) & mask;
+  }
+  return 0;
+}
+
+void wi_del(struct WinIndex *wi, Window win) {
+  if (!win || !wi->capacity) {
+    return;
+  }
+  unsigned long mask = wi->capacity - 1;
+  unsigned long i = hash(win) & mask;
+  while (wi->slots[i].win != win) {
+    if (!wi->slots[i].win) {
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+
+  // shift back any following entries which would otherwise become
+  // unreachable through the hole we're leaving.
+  unsigned long hole = i;
+  unsigned long j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    Window w = wi->slots[j].win;
+    if (!w) {
+      break;
+    }
+    unsigned long home = hash(w) & mask;
+    // can the entry at j live in the hole? only if its home slot is not
+    // cyclically within (hole, j].
+    if (((j - home) & mask) >= ((j - hole) & mask)) {
+      wi->slots[hole] = wi->slots[j];
+      hole = j;
+    }
+  }
+  wi->slots[hole].win = 0;
+  wi->slots[hole].index = 0;
+  wi->length--;
+}
@@ -0,0 +1,40 @@
+#ifndef WININDEX_H
+#define WININDEX_H
+
+#include <X11/Xlib.h>
+
+// An open-addressing hash index from a window to an array index.
+//
+// Uses linear probing with backward-shift deletion, so there are no
+// tombstones and lookups never degrade after lots of churn. Window 0 (None)
+// marks an empty slot and can't be stored.
+
+typedef struct {
+  Window win;
+  unsigned int index;
+} WinIndexSlot;
+
+struct WinIndex {
+  WinIndexSlot* slots;
+  // always a power of two
+  unsigned long capacity;
+  unsigned long length;
+};
+
+// allocate an index with room for at least n entries before it grows
+void wi_init(struct WinIndex *wi, unsigned long n);
+
+// free the storage backing the index
+void wi_free(struct WinIndex *wi);
+
+// associate win with index, replacing any existing value
+void wi_put(struct WinIndex *wi, Window win, unsigned int index);
+
+// look up the index for win. returns 1 and writes into index if found,
+// otherwise returns 0.
+int wi_get(struct WinIndex *wi, Window win, unsigned int *index);
+
+// remove win from the index. does nothing if it isn't there.
+void wi_del(struct WinIndex *wi, Window win);
+
+#endif
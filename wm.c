@@ -1,24 +1,44 @@
 #include "clientbuffer.h"
 #include "clients.h"
+#include "hist.h"
+#include "keys.h"
+#include "async.h"
+#include "log.h"
+#include "registers.h"
 #include "snap.h"
+#include "switcher.h"
+#include "timers.h"
+#include "trace.h"
+#include "xreq.h"
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <assert.h>
-#include <poll.h>
-#include <signal.h>
+#include <errno.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
 #include <time.h>
+#include <unistd.h>
 
 // timeout when switching windows for selected client to go to top of stack
 #define SWITCH_TIMEOUT_MS 600
 
+// how long to wait for the next key of a sequence, and how long a key must
+// be down to count as held
+#define KEY_SEQ_TIMEOUT_MS 1000
+#define KEY_HOLD_MS 400
+
 #define SNAP_DIST 30
 
+// maximum rate at which geometry is sent to the server while dragging.
+// 0 sends every motion.
+#define DRAG_FPS 60
+
 // what fraction of window width/height do edge handles occupy?
 #define HANDLE_FRAC 0.2
 
@@ -34,38 +54,6 @@
 // #define MODL XK_Alt_L
 // #define MODR XK_Alt_R
 
-#define LEVEL_WARN 2
-#define LEVEL_INFO 1
-#define LEVEL_FINE 0
-
-#define LOG_LEVEL LEVEL_FINE
-
-void log_msg(char level, const char* fn, char* msg, ...) {
-  if (level < LOG_LEVEL) return;
-
-  struct timespec ts;
-  struct tm *gmt;
-  clock_gettime(CLOCK_REALTIME, &ts);
-  gmt = gmtime(&ts.tv_sec);
-  char buffer[128];
-  strftime(buffer, sizeof(buffer), "%F %T", gmt);
-
-  printf("%s.%03d %s - ", buffer, (int)(ts.tv_nsec / 1e6), fn);
-
-  va_list args;
-  va_start(args, msg);
-  vprintf(msg, args);
-  va_end(args);
-
-  printf("\n");
-  fflush(stdout);
-}
-
-#define FATAL(...) { log_msg(LEVEL_WARN, __func__, __VA_ARGS__); exit(1); }
-#define WARN(...) log_msg(LEVEL_WARN, __func__, __VA_ARGS__);
-#define INFO(...) log_msg(LEVEL_INFO, __func__, __VA_ARGS__);
-#define FINE(...) log_msg(LEVEL_FINE, __func__, __VA_ARGS__);
-
 #define MAX_NONE 0
 #define MAX_BOTH 1
 #define MAX_VERT 2
@@ -79,117 +67,281 @@ unsigned int screen_width, screen_height;
 
 Window last_focused_window = 0;
 
+// ewmh title, and its type
+Atom net_wm_name, utf8_string;
+
+// icccm state. windows hidden on other workspaces are iconic, which is
+// how a restarted wm tells them from windows which were never shown.
+Atom wm_state;
+
 // we'll set this to 1 when we start cycling through windows.
 // when timer expires, we'll set it back to 0 and update the window's focus time.
 char transient_switching = 0;
 
-// index into window_focus_history
+// index into the focus history
 unsigned int transient_switching_index = 0;
 
-// flag indicating timer has expired
-char timer_expired = 0;
+// the window at that index, highlighted with switching_colour. nothing is
+// raised or focused until switching is finalized.
+Window switch_candidate = None;
+
+// fires SWITCH_TIMEOUT_MS after the last switch to finalize it
+Timer switch_timer;
+
+// fires when a held-back drag update may be sent
+Timer drag_timer;
+
+// with --outline, drags draw the window's outline on the root and only
+// move the window itself when it's dropped. the server is grabbed for the
+// drag so nothing is painted over the outline in the meantime.
+char outline_drags = 0;
+
+// running a trace with --replay. nothing is grabbed.
+char replaying = 0;
+GC outline_gc;
 
 #define MIN(a, b) ( a < b ? a : b )
 #define MAX(a, b) ( a > b ? a : b )
 
-void fetch_update_name(Window win) {
+// snap values. these are the values to which the left/right/top/bottom
+// edges should snap. each client contributes two values to each list,
+// and the screen one. they are kept up to date as clients come, go and
+// change shape, so a drag only needs to skip the dragged client. they're
+// bucketed into cells SNAP_DIST wide, so a drag only looks at the edges
+// near the ones it's moving.
+struct SnapGrid snaps_lefts;
+struct SnapGrid snaps_rights;
+struct SnapGrid snaps_tops;
+struct SnapGrid snaps_bottoms;
+
+// add (or remove) the snap values for a client, based on its current
+// bounds and border.
+void snap_track(Client *c, char add) {
+  // not known yet
+  Rectangle rect = *client_bounds(c);
+  if (!rect.w) {
+    return;
+  }
+
+  // only what's on screen is snapped to
+  if (c->workspace != clients_workspace()) {
+    return;
+  }
+
+  void (*fn)(struct SnapGrid*, int, unsigned long) =
+    add ? snap_grid_add : snap_grid_remove;
+
+  unsigned int b2 = c->border_width * 2;
+  rect.w += b2;
+  rect.h += b2;
+
+  int r = rect.x + rect.w - 1;
+  int b = rect.y + rect.h - 1;
+
+  Window win = client_win(c);
+  fn(&snaps_lefts, rect.x, win);
+  fn(&snaps_rights, r, win);
+  fn(&snaps_tops, rect.y, win);
+  fn(&snaps_bottoms, b, win);
+
+  fn(&snaps_lefts, r + BORDER_GAP + 1, win);
+  fn(&snaps_rights, rect.x - BORDER_GAP - 1, win);
+  fn(&snaps_tops, b + BORDER_GAP + 1, win);
+  fn(&snaps_bottoms, rect.y - BORDER_GAP - 1, win);
+}
+
+void snap_init() {
+  snap_grid_init(&snaps_lefts, screen_width, SNAP_DIST);
+  snap_grid_init(&snaps_rights, screen_width, SNAP_DIST);
+  snap_grid_init(&snaps_tops, screen_height, SNAP_DIST);
+  snap_grid_init(&snaps_bottoms, screen_height, SNAP_DIST);
+
+  snap_grid_add(&snaps_lefts, SCREEN_GAP, root);
+  snap_grid_add(&snaps_rights, screen_width - 1 - SCREEN_GAP, root);
+  snap_grid_add(&snaps_tops, SCREEN_GAP, root);
+  snap_grid_add(&snaps_bottoms, screen_height - 1 - SCREEN_GAP, root);
+}
+
+// longest window name we'll fetch, in 32-bit units
+#define NAME_FETCH_LEN 256
+
+// handles replies for both WM_NAME and _NET_WM_NAME. the latter is asked
+// for second, so when a client sets it, it wins.
+void name_reply(Window win, void *reply) {
   Client *c = clients_find(win).data;
   if (!c) {
     INFO("no client for %x", win);
+    return;
   }
 
-  char *name;
-  if (XFetchName(dsp, win, &name)) {
-    XFree(c->name);
-    c->name = name;
-    INFO("XFetchName found new name for %x [%s]", win, name);
+  xcb_get_property_reply_t *r = reply;
+  if (!r || r->format != 8 || !r->value_len) {
+    FINE("found no name for %x, value remains [%s]", win, c->name);
     return;
   }
 
-  // todo there is some weird behaviour around XFetchName / GetWMName /
-  // WM_NAME. It sometimes it returns a value, sometimes it does not. For
-  // firefox at least, it seems to alternate!
+  client_set_name(c, xcb_get_property_value(r),
+                  xcb_get_property_value_length(r));
+  FINE("found new name for %x [%s]", win, c->name);
+}
 
-  // XTextProperty tp;
-  // if (XGetWMName(dsp, win, &tp)) {
-  //   char** strs;
-  //   int count;
-  //   if (XTextPropertyToStringList(&tp, &strs, &count) && count > 0) {
-  //     int l = strlen(strs[0]) + 1;
-  //     name = malloc(l);
-  //     strncpy(name, strs[0], l);
-  //     name[l-1] = '\0';
-  //     XFreeStringList(strs);
-  //     INFO("XGetWMName found name %s", name);
-  //     c->name = name;
-  //   }
-  // }
+// ask for the window's name. it's filled in when the reply arrives.
+void fetch_update_name(Window win) {
+  xcb_get_property_cookie_t ck =
+    xcb_get_property(xcb, 0, win, XCB_ATOM_WM_NAME,
+                     XCB_GET_PROPERTY_TYPE_ANY, 0, NAME_FETCH_LEN);
+  async_expect(ck.sequence, win, name_reply);
+  ck = xcb_get_property(xcb, 0, win, net_wm_name, utf8_string,
+                        0, NAME_FETCH_LEN);
+  async_expect(ck.sequence, win, name_reply);
+}
 
-  INFO("found no name for %x, value remains [%s]", win, c->name);
-  return;
+// fetch the names of every client whose name has changed since it was
+// last fetched, and wait for them. titles are only needed for display, so
+// they're left alone until then.
+void refresh_names() {
+  unsigned int fetched = 0;
+  for (unsigned int i = 0; i < clients.length; i++) {
+    Client *c = cb_get(&clients, i);
+    if (c->name_dirty) {
+      c->name_dirty = 0;
+      fetch_update_name(*wb_get(&clients_wins, i));
+      fetched++;
+    }
+  }
+  if (fetched) {
+    async_collect_all();
+    FINE("refreshed %d names", fetched);
+  }
 }
 
-void manage_new_window(Window win) {
-  if (clients_find(win).data) {
-    WARN("already tracking %x", win);
+void remove_window(Window win) {
+  Client *c = clients_find(win).data;
+  if (c) {
+    snap_track(c, 0);
+  }
+  if (win == switch_candidate) {
+    switch_candidate = None;
+  }
+  clients_del(win);
+  INFO("destroyed %x", win);
+}
+
+void geometry_reply(Window win, void *reply) {
+  Client *c = clients_find(win).data;
+  xcb_get_geometry_reply_t *r = reply;
+  if (!c) {
+    return;
+  }
+  if (!r) {
+    // gone before we got to it. it won't be coming back.
+    INFO("no geometry for %x", win);
+    remove_window(win);
     return;
   }
 
-  Status st;
-  XWindowAttributes attr;
-  st = XGetWindowAttributes(dsp, win, &attr);
-  if (!st) {
-    WARN("failed to get window attributes for %x", win);
+  // a configure notify may have beaten us here, and it's more recent
+  Rectangle *bounds = client_bounds(c);
+  if (bounds->w) {
     return;
   }
 
-  if (attr.override_redirect) {
-    INFO("ignoring override_redirect window");
+  bounds->x = r->x;
+  bounds->y = r->y;
+  bounds->w = r->width;
+  bounds->h = r->height;
+  snap_track(c, 1);
+
+  INFO("%x has position [%d %d] and size [%d %d]",
+       win, r->x, r->y, r->width, r->height);
+}
+
+void set_wm_state(Window win, long state) {
+  long data[2] = { state, None };
+  XChangeProperty(dsp, win, wm_state, wm_state, 32, PropModeReplace,
+                  (unsigned char*)data, 2);
+}
+
+// start managing win. if bounds is NULL, they're requested from the
+// server and filled in when the reply arrives; until then the client's
+// bounds are all zero.
+void manage_new_window(Window win, Rectangle *bounds) {
+  if (clients_find(win).data) {
+    WARN("already tracking %x", win);
     return;
   }
 
-  // char *name;
-  // if (XFetchName(dsp, win, &name)) {
-  //   INFO("initial name for %x is [%s]", win, name);
-  // } else {
-  //   name = NULL;
-  //   INFO("no initial name for %x", win);
-  // }
-
-  Client c;
-  c.win = win;
-  c.current_bounds.x = attr.x;
-  c.current_bounds.y = attr.y;
-  c.current_bounds.w = attr.width;
-  c.current_bounds.h = attr.height;
+  Client c = {0};
   c.max_state = MAX_NONE;
   c.border_width = BORDER_WIDTH;
   c.name = NULL;
-  clients_add(&c);
-
-  fetch_update_name(win);
+  c.name_dirty = 1;
+  c.workspace = clients_workspace();
+  Rectangle initial = {0};
+  if (bounds) {
+    initial = *bounds;
+  }
+  clients_add(win, initial, &c);
+  snap_track(clients_find(win).data, 1);
+
+  // a replayed window doesn't exist on the display we're replaying onto,
+  // so the reply would only remove it again. the recorded configure
+  // notifies say where it is instead.
+  if (!bounds && !replaying) {
+    xcb_get_geometry_cookie_t ck = xcb_get_geometry(xcb, win);
+    async_expect(ck.sequence, win, geometry_reply);
+  }
+  if (!bounds) {
+    // created a while ago, perhaps, and since buried
+    xreq_sync_stacking(win);
+  }
 
-  XSetWindowBorderWidth(dsp, win, c.border_width);
-  XSetWindowBorder(dsp, win, unfocused_colour.pixel);
+  xreq_border_width(win, c.border_width);
+  xreq_border_colour(win, unfocused_colour.pixel);
   XSelectInput(dsp, win, EnterWindowMask | FocusChangeMask | PropertyChangeMask);
+  set_wm_state(win, NormalState);
 
-  INFO("added %x with position [%d %d] and size [%d %d]",
-       win, attr.x, attr.y, attr.width, attr.height);
-}
-
-void remove_window(Window win) {
-  clients_del(win);
-  INFO("destroyed %x", win);
+  INFO("added %x", win);
 }
 
 void handle_map_request(XMapRequestEvent* event) {
   Window win = event->window;
-  FINE("manage and map %x", win);
-  manage_new_window(event->window);
+  Client *c = clients_find(win).data;
+  if (c && c->workspace != clients_workspace()) {
+    // a hidden window wants to be seen. bring it here.
+    INFO("moving %x to workspace %d", win, clients_workspace() + 1);
+    clients_move_to_workspace(win, clients_workspace());
+    snap_track(c, 1);
+    xreq_raise(win);
+    set_wm_state(win, NormalState);
+  } else {
+    FINE("manage and map %x", win);
+    manage_new_window(event->window, NULL);
+  }
   XMapWindow(dsp, win);
 }
 
+void handle_map_notify(XMapEvent* event) {
+  Client *c = clients_find(event->window).data;
+  if (c) {
+    // shown by a workspace switch, or a new client, which is already on
+    // top of our stacking order
+    return;
+  }
+  // probably an override-redirect window, now on top of everything
+  xreq_note_restacked();
+}
+
 void handle_unmap_notify(XUnmapEvent* event) {
+  Client *c = clients_find(event->window).data;
+  if (c && c->unmaps_expected && !event->send_event) {
+    // hidden by us, not withdrawn
+    c->unmaps_expected--;
+    return;
+  }
+  if (c) {
+    XDeleteProperty(dsp, event->window, wm_state);
+  }
   remove_window(event->window);
 }
 
@@ -229,75 +381,26 @@ struct {
   int start_win_w;
   int start_win_h;
   enum DragKind kind;
+
+  // geometry from the latest motion, and the geometry last sent to the
+  // server (or drawn as the outline). pending is only sent when it differs
+  // from sent.
+  Rectangle pending;
+  Rectangle sent;
+  long long sent_at_us;
+
+  // of the window being dragged, for drawing its outline
+  int border_width;
 } drag_state;
 
 // flag indicating whether a modifier press is followed by something else.
 // if it's not, then we can use it to switch windows.
 char prime_mod = 0;
 
-// snap values. these are the values to which the left/right/top/bottom
-// edges should snap. they are set at drag-start, otherwise null.
-int *snaps_lefts = NULL;
-int *snaps_rights = NULL;
-int *snaps_tops = NULL;
-int *snaps_bottoms = NULL;
-
-// number of values in each snap list.
-unsigned int snap_count;
-
-// Make snap lists for edges: lefts, rights, tops, bottoms. These are the
-// values for each edge which we can snap to. The pointer written into
-// lefts needs to be freed by the caller. The other pointers share this
-// same memory. Returns the number of elements in each list.
-unsigned int make_snap_lists(Client* skip, int** ls, int** rs, int** ts, int** bs) {
-  assert(skip), assert(ls), assert(rs), assert(ts), assert(bs);
-
-  unsigned int nc = clients.length - 1;
-  // 2 edges per client, 1 edge for the screen
-  unsigned int edges = nc * 2 + 1;
-  unsigned int cells = edges * 4;
-  int* mem = malloc(sizeof(int) * cells);
-  *ls = mem;
-  *rs = mem + edges;
-  *ts = mem + edges * 2;
-  *bs = mem + edges * 3;
-
-  unsigned int count = 0;
-  for (unsigned int ci = 0; ci < clients.length; ci++) {
-    Client* c = cb_get(&clients, ci);
-    if (skip == c) {
-      continue;
-    }
-
-    unsigned int b2 = c->border_width * 2;
-    Rectangle rect = c->current_bounds;
-    rect.w += b2;
-    rect.h += b2;
-
-    int r = rect.x + rect.w - 1;
-    int b = rect.y + rect.h - 1;
-
-    (*ls)[count] = rect.x;
-    (*rs)[count] = r;
-    (*ts)[count] = rect.y;
-    (*bs)[count] = b;
-    count++;
-
-    (*ls)[count] = r + BORDER_GAP + 1;
-    (*rs)[count] = rect.x - BORDER_GAP - 1;
-    (*ts)[count] = b + BORDER_GAP + 1;
-    (*bs)[count] = rect.y - BORDER_GAP - 1;
-    count++;
-  }
-
-  (*ls)[count] = SCREEN_GAP;
-  (*rs)[count] = screen_width - 1 - SCREEN_GAP;
-  (*ts)[count] = SCREEN_GAP;
-  (*bs)[count] = screen_height - 1 - SCREEN_GAP;
-  count++;
-
-  assert(count == edges);
-  return edges;
+// draw, or since it's xor'd, erase the outline of a window with bounds r
+void outline_draw(Rectangle r) {
+  int b2 = 2 * drag_state.border_width;
+  XDrawRectangle(dsp, root, outline_gc, r.x, r.y, r.w + b2 - 1, r.h + b2 - 1);
 }
 
 void drag_start(Window win, int cursor_x, int cursor_y) {
@@ -307,7 +410,7 @@ void drag_start(Window win, int cursor_x, int cursor_y) {
     return;
   }
 
-  Rectangle bounds = c->current_bounds;
+  Rectangle bounds = *client_bounds(c);
 
   int x1, x2, y1, y2;
   x1 = bounds.x + bounds.w * HANDLE_FRAC;
@@ -362,26 +465,79 @@ void drag_start(Window win, int cursor_x, int cursor_y) {
   drag_state.start_mouse_x = cursor_x;
   drag_state.start_mouse_y = cursor_y;
   drag_state.kind = dk;
+  drag_state.pending = bounds;
+  drag_state.sent = bounds;
+  drag_state.sent_at_us = 0;
+  drag_state.border_width = c->border_width;
 
   // any manual resize/move reverts the maximization state
   // todo this should really happen on move, not press
   c->max_state = MAX_NONE;
 
-  snap_count =
-    make_snap_lists(c, &snaps_lefts, &snaps_rights,
-                    &snaps_tops, &snaps_bottoms);
+  xreq_raise(win);
+
+  if (outline_drags) {
+    // raise now rather than after the drain. exposing the window would
+    // paint its background over parts of the outline.
+    xreq_flush_stacking();
+    XGrabServer(dsp);
+    outline_draw(bounds);
+  }
+}
+
+char rect_eq(Rectangle a, Rectangle b) {
+  return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+// send the pending drag geometry, if it has changed and either a frame
+// has passed since the last send or force is set. if it's held back,
+// drag_timer will try again once the frame is up.
+void drag_flush(char force) {
+  if (drag_state.win == 0 || rect_eq(drag_state.pending, drag_state.sent)) {
+    return;
+  }
+
+  long long now = timers_now_us();
+  long long wait = 0;
+  if (!force && DRAG_FPS) {
+    wait = drag_state.sent_at_us + 1000000 / DRAG_FPS - now;
+  }
+  if (wait > 0) {
+    if (!drag_timer.pending) {
+      timer_set(&drag_timer, wait);
+    }
+    return;
+  }
+
+  Rectangle r = drag_state.pending;
+  if (outline_drags) {
+    outline_draw(drag_state.sent);
+    outline_draw(r);
+  } else {
+    xreq_move_resize(drag_state.win, r);
+  }
+  drag_state.sent = r;
+  drag_state.sent_at_us = now;
+  timer_cancel(&drag_timer);
+}
 
-  XRaiseWindow(dsp, win);
+void drag_frame_due() {
+  drag_flush(0);
 }
 
 void drag_end() {
+  if (outline_drags) {
+    // the one move of the whole drag
+    timer_cancel(&drag_timer);
+    outline_draw(drag_state.sent);
+    XUngrabServer(dsp);
+    xreq_move_resize(drag_state.win, drag_state.pending);
+  } else {
+    // whatever the pacing, the window ends up where it was dropped
+    drag_flush(1);
+    timer_cancel(&drag_timer);
+  }
   drag_state.win = 0;
-  free(snaps_lefts);
-  snaps_lefts = NULL;
-  snaps_rights = NULL;
-  snaps_tops = NULL;
-  snaps_bottoms = NULL;
-  snap_count = 0;
 }
 
 void handle_button_press(XButtonEvent* event) {
@@ -404,7 +560,7 @@ void handle_button_release(XButtonEvent* event) {
     // todo raise, focus, and track focus change
   } else if (event->button == 3) {
     Window win = event->subwindow;
-    XLowerWindow(dsp, win);
+    xreq_lower(win);
   }
 }
 
@@ -418,7 +574,7 @@ void toggle_maximize(Window win, char kind) {
   }
 
   Rectangle new;
-  Rectangle cur = c->current_bounds;
+  Rectangle cur = *client_bounds(c);
   if (c->max_state == kind) {
     // restore orig if we're toggling the same kind as current
     c->max_state = MAX_NONE;
@@ -451,47 +607,60 @@ void toggle_maximize(Window win, char kind) {
       break;
     }
   }
-  XMoveResizeWindow(dsp, win, new.x, new.y, new.w, new.h);
+  xreq_move_resize(win, new);
 }
 
 void track_focus_change(Client *focused) {
-  Window win = focused->win;
-  XSetWindowBorder(dsp, win, focused_colour.pixel);
+  Window win = client_win(focused);
+  xreq_border_colour(win, focused_colour.pixel);
   clients_focus_raise(win);
 }
 
-void timer_handler(int signal) {
-  timer_expired = 1;
-}
-
-// finalize transient switching. make the currently transiently focused
-// window really focused.
+// finalize transient switching. raise and focus the candidate, which
+// until now has only been highlighted.
 void finalize_window_switching() {
   if (!transient_switching) {
     return;
   }
 
   transient_switching = 0;
+  Window win = switch_candidate;
+  switch_candidate = None;
 
-  Client *c = clients_find(last_focused_window).data;
+  Client *c = clients_find(win).data;
   if (!c) {
-    WARN("focus on un-tracked window: %x", last_focused_window);
+    WARN("focus on un-tracked window: %x", win);
     return;
   }
 
+  xreq_raise(win);
+  XSetInputFocus(dsp, win, RevertToParent, CurrentTime);
+  // don't wait for the focus-in. it won't come at all if the candidate
+  // already had focus, and the history should be right for whatever runs
+  // next.
   track_focus_change(c);
 }
 
+// highlight the next candidate, putting the previous one's border back
 void switch_next_window() {
-  if (++transient_switching_index >= window_focus_history.length) {
+  if (++transient_switching_index >= window_history_length()) {
     transient_switching_index = 0;
   }
 
   Window win = window_history_get(transient_switching_index);
+  if (!win) {
+    return;
+  }
 
-  FINE("transient focus to %x", win);
-  XRaiseWindow(dsp, win);
-  XSetInputFocus(dsp, win, RevertToParent, CurrentTime);
+  if (switch_candidate != None && switch_candidate != win) {
+    char focused = switch_candidate == last_focused_window;
+    xreq_border_colour(switch_candidate, focused ?
+                       focused_colour.pixel : unfocused_colour.pixel);
+  }
+  switch_candidate = win;
+
+  FINE("switching candidate %x", win);
+  xreq_border_colour(win, switching_colour.pixel);
 }
 
 void switch_windows() {
@@ -501,12 +670,7 @@ void switch_windows() {
   }
 
   // reset the timer
-  struct itimerval t;
-  t.it_value.tv_sec = 0;
-  t.it_value.tv_usec = SWITCH_TIMEOUT_MS * 1000;
-  t.it_interval.tv_sec = 0;
-  t.it_interval.tv_usec = 0;
-  setitimer(ITIMER_REAL, &t, NULL);
+  timer_set(&switch_timer, SWITCH_TIMEOUT_MS * 1000LL);
 
   switch_next_window();
 }
@@ -536,12 +700,17 @@ void maximize_vert() {
 
 void close_window() {
   Window win = get_target_window();
-  XDestroyWindow(dsp, win);
+  if (win) {
+    XDestroyWindow(dsp, win);
+  }
 }
 
 void lower() {
   Window win0 = get_target_window();
   Window win1 = window_history_get(1);
+  if (!win0) {
+    return;
+  }
 
   Client *c = clients_find(win1).data;
   if (!c) {
@@ -550,22 +719,94 @@ void lower() {
   }
 
   clients_focus_lower(win0);
-  XLowerWindow(dsp, win0);
+  xreq_lower(win0);
   XWarpPointer(dsp, 0, win1,
                0, 0, 0, 0,
-               c->current_bounds.w / 2,
-               c->current_bounds.h / 2);
+               client_bounds(c)->w / 2,
+               client_bounds(c)->h / 2);
   XSetInputFocus(dsp, win1, RevertToParent, CurrentTime);
 
   INFO("%x goes to back, focus %x", win0, win1);
 }
 
+// handler latency in ns for each event type, and the number of events
+// queued behind each one, and the number handled per drain.
+Histogram event_latency[LASTEvent];
+Histogram queue_depth;
+Histogram drain_size;
+
+const char* event_names[LASTEvent] = {
+  [KeyPress] = "key press",
+  [KeyRelease] = "key release",
+  [ButtonPress] = "button press",
+  [ButtonRelease] = "button release",
+  [MotionNotify] = "motion notify",
+  [EnterNotify] = "enter notify",
+  [FocusIn] = "focus in",
+  [FocusOut] = "focus out",
+  [Expose] = "expose",
+  [DestroyNotify] = "destroy notify",
+  [MapNotify] = "map notify",
+  [UnmapNotify] = "unmap notify",
+  [MapRequest] = "map request",
+  [ReparentNotify] = "reparent notify",
+  [ConfigureNotify] = "configure notify",
+  [ConfigureRequest] = "configure request",
+  [PropertyNotify] = "property notify",
+  [MappingNotify] = "mapping notify",
+};
+
+// nanoseconds on the monotonic clock
+long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void log_stats() {
+  INFO("%-18s %8s %9s %9s %9s %9s",
+       "handler latency", "count", "p50 us", "p99 us", "p999 us", "max us");
+  for (unsigned int i = 0; i < LASTEvent; i++) {
+    Histogram *h = &event_latency[i];
+    if (!h->total) {
+      continue;
+    }
+    char other[32];
+    const char *name = event_names[i];
+    if (!name) {
+      snprintf(other, sizeof(other), "event %u", i);
+      name = other;
+    }
+    INFO("%-18s %8lu %9.1f %9.1f %9.1f %9.1f",
+         name, h->total,
+         hist_percentile(h, 0.5) / 1e3,
+         hist_percentile(h, 0.99) / 1e3,
+         hist_percentile(h, 0.999) / 1e3,
+         h->max / 1e3);
+  }
+
+  Histogram *counts[] = { &queue_depth, &drain_size };
+  const char *count_names[] = { "queue depth", "drain size" };
+  for (unsigned int i = 0; i < 2; i++) {
+    Histogram *h = counts[i];
+    INFO("%-18s %8lu %9llu %9llu %9llu %9llu",
+         count_names[i], h->total,
+         hist_percentile(h, 0.5),
+         hist_percentile(h, 0.99),
+         hist_percentile(h, 0.999),
+         h->max);
+  }
+}
+
 void log_debug() {
+  refresh_names();
   INFO("%d clients", clients.length);
   for (unsigned int i = 0; i < clients.length; i++) {
     Client *c = cb_get(&clients, i);
-    INFO("%8x %s", c->win, c->name);
+    INFO("%8x %d %s", *wb_get(&clients_wins, i), c->workspace + 1, c->name);
   }
+  log_stats();
+  xreq_log_stats();
 }
 
 void toggle_border() {
@@ -576,6 +817,7 @@ void toggle_border() {
     return;
   }
 
+  snap_track(c, 0);
   int delta;
   if (c->border_width) {
     c->border_width = 0;
@@ -584,27 +826,172 @@ void toggle_border() {
     c->border_width = BORDER_WIDTH;
     delta = BORDER_WIDTH * -2;
   }
-  XSetWindowBorderWidth(dsp, win, c->border_width);
-  XResizeWindow(dsp, win,
-                c->current_bounds.w + delta,
-                c->current_bounds.h + delta);
+  snap_track(c, 1);
+  xreq_border_width(win, c->border_width);
+  xreq_resize(win,
+              client_bounds(c)->w + delta,
+              client_bounds(c)->h + delta);
+}
+
+// focus whatever was last focused on the current workspace
+void focus_workspace_top() {
+  Window top = window_history_get(0);
+  if (top) {
+    XSetInputFocus(dsp, top, RevertToParent, CurrentTime);
+  } else {
+    XSetInputFocus(dsp, PointerRoot, RevertToPointerRoot, CurrentTime);
+  }
 }
 
-Window switcher_window = None;
-void make_switcher() {
-  switcher_window = XCreateSimpleWindow(dsp, root, 0, 0, 600, 200, 0, 0, 0);
-  if (!switcher_window) {
-    WARN("failed to make window");
+// hide the windows of the current workspace and show those of ws. this
+// only queues requests, which go out together in the main loop's flush
+// after the drain, so switching costs no round trips however many windows
+// are involved.
+void workspace_switch(unsigned int ws) {
+  finalize_window_switching();
+  unsigned int old = clients_workspace();
+  if (ws == old) {
     return;
   }
 
-  XSetWindowAttributes attr;
-  attr.event_mask = ExposureMask;
-  XChangeWindowAttributes(dsp, switcher_window, CWEventMask, &attr);
+  // map the new windows before unmapping the old so the root doesn't show
+  // through in between
+  unsigned int shown = 0;
+  unsigned int hidden = 0;
+  for (unsigned int i = 0; i < clients.length; i++) {
+    Client *c = cb_get(&clients, i);
+    if (c->workspace == ws) {
+      XMapWindow(dsp, *wb_get(&clients_wins, i));
+      set_wm_state(*wb_get(&clients_wins, i), NormalState);
+      shown++;
+    }
+  }
+  for (unsigned int i = 0; i < clients.length; i++) {
+    Client *c = cb_get(&clients, i);
+    if (c->workspace == old) {
+      snap_track(c, 0);
+      c->unmaps_expected++;
+      XUnmapWindow(dsp, *wb_get(&clients_wins, i));
+      set_wm_state(*wb_get(&clients_wins, i), IconicState);
+      hidden++;
+    }
+  }
 
-  XMapWindow(dsp, switcher_window);
+  clients_set_workspace(ws);
+  for (unsigned int i = 0; i < clients.length; i++) {
+    Client *c = cb_get(&clients, i);
+    if (c->workspace == ws) {
+      snap_track(c, 1);
+    }
+  }
+
+  focus_workspace_top();
+  INFO("workspace %d to %d, showed %d and hid %d", old + 1, ws + 1, shown, hidden);
+}
+
+// move the focused window to workspace ws
+void workspace_send(unsigned int ws) {
+  Window win = get_target_window();
+  Client *c = clients_find(win).data;
+  if (!c || c->workspace == ws) {
+    return;
+  }
+
+  snap_track(c, 0);
+  c->unmaps_expected++;
+  XUnmapWindow(dsp, win);
+  set_wm_state(win, IconicState);
+  clients_move_to_workspace(win, ws);
+  focus_workspace_top();
+  INFO("sent %x to workspace %d", win, ws + 1);
+}
+
+void register_save_client(unsigned int r, Client *c) {
+  Configuration conf = {
+    .win = client_win(c),
+    .bounds = *client_bounds(c),
+    .orig_bounds = c->orig_bounds,
+    .max_state = c->max_state,
+    .border_width = c->border_width,
+  };
+  register_append(r, &conf);
+}
+
+// save every client's configuration into register r
+void register_save(unsigned int r) {
+  finalize_window_switching();
+  register_clear(r);
+
+  // top to bottom of the stacking order, so a restore stacks them as they
+  // are now
+  for (Window win = clients_stack_top(); win; win = clients_stack_below(win)) {
+    register_save_client(r, clients_find(win).data);
+  }
+  INFO("saved %d windows to register %d", register_length(r), r + 1);
+}
+
+// put every window saved in register r back how it was. all the requests
+// are queued, then go out in one flush after the drain, so the windows
+// move together rather than one after another.
+void register_restore(unsigned int r) {
+  finalize_window_switching();
+  unsigned int n = register_length(r);
+  Window *stack = malloc(sizeof(Window) * (n ? n : 1));
+  unsigned int restored = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    Configuration conf;
+    register_get(r, i, &conf);
+    Client *c = clients_find(conf.win).data;
+    if (!c) {
+      // gone since
+      continue;
+    }
+
+    c->max_state = conf.max_state;
+    c->orig_bounds = conf.orig_bounds;
+    if (c->border_width != conf.border_width) {
+      snap_track(c, 0);
+      c->border_width = conf.border_width;
+      snap_track(c, 1);
+    }
+    xreq_border_width(conf.win, conf.border_width);
+    xreq_move_resize(conf.win, conf.bounds);
+    stack[restored++] = conf.win;
+  }
+  xreq_restack(stack, restored);
+  free(stack);
+  INFO("restored %d of %d windows from register %d", restored, n, r + 1);
 }
 
+#define REGISTER_FNS(n) \
+  void register_save_##n() { register_save(n - 1); } \
+  void register_restore_##n() { register_restore(n - 1); }
+
+REGISTER_FNS(1)
+REGISTER_FNS(2)
+REGISTER_FNS(3)
+REGISTER_FNS(4)
+REGISTER_FNS(5)
+REGISTER_FNS(6)
+REGISTER_FNS(7)
+REGISTER_FNS(8)
+REGISTER_FNS(9)
+
+// bindings can't take arguments, so there's a pair of these per workspace
+#define WORKSPACE_FNS(n) \
+  void workspace_switch_##n() { workspace_switch(n - 1); } \
+  void workspace_send_##n() { workspace_send(n - 1); }
+
+WORKSPACE_FNS(1)
+WORKSPACE_FNS(2)
+WORKSPACE_FNS(3)
+WORKSPACE_FNS(4)
+WORKSPACE_FNS(5)
+WORKSPACE_FNS(6)
+WORKSPACE_FNS(7)
+WORKSPACE_FNS(8)
+WORKSPACE_FNS(9)
+
 typedef struct {
   KeySym sym;
   unsigned int mods;
@@ -615,23 +1002,114 @@ typedef struct {
   void (*binding)();
 } Key;
 
-Key keys[] = {
-  { XK_M, MODMASK, 0, maximize },
-  { XK_V, MODMASK, 0, maximize_vert},
-  { XK_H, MODMASK, 0, maximize_horiz},
-  { XK_D, MODMASK, 0, log_debug},
-  { XK_Q, MODMASK, 0, close_window},
-  { XK_B, MODMASK, 0, toggle_border},
-  // { XK_S, MODMASK, 0, make_switcher},
-  { XK_Escape, MODMASK, 0, lower },
+// mod+n switches to workspace n, mod+shift+n sends the focused window there
+#define WORKSPACE_KEYS(n) \
+  { { { XK_##n, MODMASK } }, workspace_switch_##n }, \
+  { { { XK_##n, MODMASK | ShiftMask } }, workspace_send_##n }
+
+// with mod held, r then n restores register n. with shift held too, it
+// saves to it.
+#define REGISTER_KEYS(n) \
+  { { { XK_R, MODMASK }, { XK_##n, MODMASK } }, register_restore_##n }, \
+  { { { XK_R, MODMASK | ShiftMask }, { XK_##n, MODMASK | ShiftMask } }, register_save_##n }
+
+// see keys.h for sequences and held keys
+KeyBinding bindings[] = {
+  { { { XK_M, MODMASK } }, maximize },
+  { { { XK_V, MODMASK } }, maximize_vert},
+  { { { XK_H, MODMASK } }, maximize_horiz},
+  { { { XK_D, MODMASK } }, log_debug},
+  { { { XK_Q, MODMASK } }, close_window},
+  { { { XK_B, MODMASK } }, toggle_border},
+  { { { XK_S, MODMASK } }, switcher_toggle},
+  { { { XK_Escape, MODMASK } }, lower },
+  WORKSPACE_KEYS(1),
+  WORKSPACE_KEYS(2),
+  WORKSPACE_KEYS(3),
+  WORKSPACE_KEYS(4),
+  WORKSPACE_KEYS(5),
+  WORKSPACE_KEYS(6),
+  WORKSPACE_KEYS(7),
+  WORKSPACE_KEYS(8),
+  WORKSPACE_KEYS(9),
+  REGISTER_KEYS(1),
+  REGISTER_KEYS(2),
+  REGISTER_KEYS(3),
+  REGISTER_KEYS(4),
+  REGISTER_KEYS(5),
+  REGISTER_KEYS(6),
+  REGISTER_KEYS(7),
+  REGISTER_KEYS(8),
+  REGISTER_KEYS(9),
 };
 
 Key kmodl = { MODL, 0, 0, switch_windows };
 Key kmodr = { MODR, 0, 0, switch_windows };
 
+// grab kc with mods, whatever the state of caps and num lock
+void grab_key(KeyCode kc, unsigned int mods) {
+  unsigned int locks[] = { 0, LockMask, Mod2Mask, LockMask | Mod2Mask };
+  for (unsigned int i = 0; i < sizeof(locks) / sizeof(locks[0]); i++) {
+    XGrabKey(dsp, kc, mods | locks[i], root, False, GrabModeAsync, GrabModeAsync);
+  }
+}
+
+KeyCode keysym_to_keycode(KeySym sym) {
+  return XKeysymToKeycode(dsp, sym);
+}
+
+// a key sequence is under way, so the rest of it needs to come to us
+void grab_keyboard(char grab) {
+  if (replaying) {
+    return;
+  }
+  if (grab) {
+    XGrabKeyboard(dsp, root, False, GrabModeAsync, GrabModeAsync, CurrentTime);
+  } else {
+    XUngrabKeyboard(dsp, CurrentTime);
+  }
+}
+
+// build the key table for the current keyboard mapping
+void build_keys() {
+  unsigned int count = sizeof(bindings) / sizeof(KeyBinding);
+  keys_build(bindings, count, keysym_to_keycode);
+  kmodr.kc = XKeysymToKeycode(dsp, kmodr.sym);
+  kmodl.kc = XKeysymToKeycode(dsp, kmodl.sym);
+}
+
+// build the key table, and grab the first key of every binding
+void setup_keys() {
+  XUngrabKey(dsp, AnyKey, AnyModifier, root);
+  build_keys();
+  unsigned int count = sizeof(bindings) / sizeof(KeyBinding);
+  for (unsigned int i = 0; i < count; i++) {
+    KeyStroke *first = &bindings[i].strokes[0];
+    KeyCode kc = XKeysymToKeycode(dsp, first->sym);
+    if (kc) {
+      grab_key(kc, first->mods);
+    }
+  }
+
+  grab_key(kmodr.kc, kmodr.mods);
+  grab_key(kmodl.kc, kmodl.mods);
+}
+
+void handle_mapping(XMappingEvent *event) {
+  XRefreshKeyboardMapping(event);
+  if (event->request != MappingPointer) {
+    INFO("keyboard mapping changed");
+    if (replaying) {
+      build_keys();
+    } else {
+      setup_keys();
+    }
+  }
+}
+
 void handle_key_press(XKeyEvent *event) {
   KeyCode ekc = event->keycode;
-  INFO("key: %d", ekc);
+  FINE("key: %d", ekc);
   if (ekc == kmodl.kc || ekc == kmodr.kc) {
     prime_mod = 1;
     return;
@@ -639,19 +1117,20 @@ void handle_key_press(XKeyEvent *event) {
     prime_mod = 0;
   }
 
-  for (unsigned int i = 0; i < sizeof(keys) / sizeof(Key); i++) {
-    Key k = keys[i];
-    if (k.kc == ekc) {
-      INFO("running binding for key index %d", i);
-      (k.binding)();
-      return;
-    }
+  // modifiers pressed part way through a sequence aren't part of it
+  if (IsModifierKey(XLookupKeysym(event, 0))) {
+    return;
+  }
+
+  if (!keys_press(ekc, event->state)) {
+    FINE("no binding for key %d state %x", ekc, event->state);
   }
 }
 
 void handle_key_release(XKeyEvent *event) {
   KeyCode ekc = event->keycode;
-  INFO("key: %d", ekc);
+  FINE("key: %d", ekc);
+  keys_release(ekc);
 
   if (prime_mod == 0) {
     return;
@@ -760,20 +1239,17 @@ void handle_motion(XMotionEvent* event) {
     return;
   }
 
-  assert(snaps_lefts);
-  assert(snaps_rights);
-  assert(snaps_tops);
-  assert(snaps_bottoms);
-  int l = snap(rect.x, snaps_lefts, snap_count, SNAP_DIST);
-  int r = snap(rect.x + rect.w - 1, snaps_rights, snap_count, SNAP_DIST);
-  int t = snap(rect.y, snaps_tops, snap_count, SNAP_DIST);
-  int b = snap(rect.y + rect.h - 1, snaps_bottoms, snap_count, SNAP_DIST);
+  int l = snap_grid_query(&snaps_lefts, rect.x, SNAP_DIST, win);
+  int r = snap_grid_query(&snaps_rights, rect.x + rect.w - 1, SNAP_DIST, win);
+  int t = snap_grid_query(&snaps_tops, rect.y, SNAP_DIST, win);
+  int b = snap_grid_query(&snaps_bottoms, rect.y + rect.h - 1, SNAP_DIST, win);
 
   int b2 = 2 * c->border_width;
-  XMoveResizeWindow(dsp, win,
-                    l, t,
-                    r - l - b2 + 1,
-                    b - t - b2 + 1);
+  drag_state.pending.x = l;
+  drag_state.pending.y = t;
+  drag_state.pending.w = r - l - b2 + 1;
+  drag_state.pending.h = b - t - b2 + 1;
+  drag_flush(0);
 }
 
 void handle_focus_in(XFocusChangeEvent *event) {
@@ -787,8 +1263,7 @@ void handle_focus_in(XFocusChangeEvent *event) {
   FINE("focus in for %x", win);
 
   if (transient_switching) {
-    // focus change is temporary
-    XSetWindowBorder(dsp, win, switching_colour.pixel);
+    // whatever this is, finalizing will move focus to the candidate
     return;
   }
 
@@ -808,7 +1283,11 @@ void handle_focus_out(XFocusChangeEvent* event) {
   }
 
   Window win = event->window;
-  XSetWindowBorder(dsp, win, unfocused_colour.pixel);
+  if (transient_switching && win == switch_candidate) {
+    // keep the highlight
+    return;
+  }
+  xreq_border_colour(win, unfocused_colour.pixel);
   FINE("focus out for %x", win);
 }
 
@@ -824,14 +1303,21 @@ void handle_configure(XConfigureEvent* event) {
 
   Client* c = clients_find(win).data;
   if (!c) {
+    // probably an override-redirect window, which may have been stacked
+    // over everything
     INFO("no client for %x", win);
+    xreq_note_restacked();
     return;
   }
 
-  c->current_bounds.x = x;
-  c->current_bounds.y = y;
-  c->current_bounds.w = w;
-  c->current_bounds.h = h;
+  xreq_note_configure(c, event);
+  snap_track(c, 0);
+  Rectangle *bounds = client_bounds(c);
+  bounds->x = x;
+  bounds->y = y;
+  bounds->w = w;
+  bounds->h = h;
+  snap_track(c, 1);
 }
 
 void handle_configure_request(XConfigureRequestEvent* event) {
@@ -840,17 +1326,45 @@ void handle_configure_request(XConfigureRequestEvent* event) {
   INFO("configure request for %x with [%d %d] [%d %d]",
        win, event->x, event->y, event->width, event->height);
 
-  // Client* c = clients_find(win).data;
-  // if (!c) {
-  //   FINE("no client for window %x", win);
-  //   return;
-  // }
+  Client *c = clients_find(win).data;
+  if (event->value_mask & CWStackMode) {
+    if (!c) {
+      XWindowChanges changes;
+      changes.sibling = event->above;
+      changes.stack_mode = event->detail;
+      XConfigureWindow(dsp, win, event->value_mask & (CWSibling | CWStackMode),
+                       &changes);
+    } else if (!(event->value_mask & CWSibling)) {
+      // raising and lowering go through our stacking order. stacking
+      // relative to a sibling isn't supported.
+      if (event->detail == Above) {
+        xreq_raise(win);
+      } else if (event->detail == Below) {
+        xreq_lower(win);
+      }
+    }
+  }
 
-  // ahhhh so we get configure notifies first!!
-  // need to create clients a bit more eagerly?
+  // through xreq, so its record of what we've asked for stays right. until
+  // we know where a client is, there's nothing to fill in the gaps with.
+  if (c && c->sent_bounds.w) {
+    Rectangle r = c->sent_bounds;
+    if (event->value_mask & CWX) {
+      r.x = event->x;
+    }
+    if (event->value_mask & CWY) {
+      r.y = event->y;
+    }
+    if (event->value_mask & CWWidth) {
+      r.w = event->width;
+    }
+    if (event->value_mask & CWHeight) {
+      r.h = event->height;
+    }
+    xreq_move_resize(win, r);
+    return;
+  }
 
-  // todo a & b && a & c
-  // a & (a | b) ??
   if (event->value_mask & CWX &&
       event->value_mask & CWY) {
     XMoveWindow(dsp, win, event->x, event->y);
@@ -882,6 +1396,7 @@ void handle_reparent(XReparentEvent *event) {
 }
 
 void log_event_begin(char *event_name) {
+#if LOG_LEVEL <= LEVEL_FINE
   static unsigned int fill_len = 80;
 
   char buffer[fill_len];
@@ -895,140 +1410,310 @@ void log_event_begin(char *event_name) {
   buffer[len] = ' ';
 
   FINE(buffer);
+#endif
 }
 
 void handle_property(XPropertyEvent* event) {
   Atom atom = event->atom;
   Window win = event->window;
-  INFO("new property for %lx", win);
-  if (atom == XA_WM_NAME && event->state == PropertyNewValue) {
-    fetch_update_name(win);
+  FINE("new property for %lx", win);
+  if (atom == XA_WM_NAME || atom == net_wm_name) {
+    Client *c = clients_find(win).data;
+    if (c) {
+      c->name_dirty = 1;
+    }
   }
 }
 
 void handle_expose(XExposeEvent* event) {
-  if (event->window != switcher_window) {
+  if (event->window != switcher_window()) {
     FINE("not the switcher");
     return;
   }
+  switcher_expose(event);
+}
 
-  XClearWindow(dsp, switcher_window);
-
-  // todo free
-  XFontStruct* font = XLoadQueryFont(dsp, "fixed");
-  int height = font->ascent + font->descent;
+// run the handler for an event, timing it
+void dispatch_event(XEvent *event) {
+  long long t0 = now_ns();
 
-  XGCValues vals;
-  vals.foreground = XWhitePixel(dsp, 0);
-  vals.font = font->fid;
-  GC gc = XCreateGC(dsp, switcher_window,
-                    GCForeground | GCFont,
-                    &vals);
+  switch (event->type) {
+  case MapRequest:
+    log_event_begin("map request");
+    handle_map_request((XMapRequestEvent*)&event->xmaprequest);
+    break;
+  case MapNotify:
+    log_event_begin("map notify");
+    handle_map_notify((XMapEvent*)&event->xmap);
+    break;
+  case UnmapNotify:
+    log_event_begin("unmap notify");
+    handle_unmap_notify((XUnmapEvent*)&event->xunmap);
+    break;
+  case EnterNotify:
+    log_event_begin("enter notify");
+    handle_enter_notify((XCrossingEvent*)&event->xcrossing);
+    break;
+  case ButtonPress:
+    log_event_begin("button press");
+    handle_button_press((XButtonEvent*)&event->xbutton);
+    break;
+  case ButtonRelease:
+    log_event_begin("button release");
+    handle_button_release((XButtonEvent*)&event->xbutton);
+    break;
+  case KeyPress:
+    log_event_begin("key press");
+    handle_key_press((XKeyEvent*)&event->xkey);
+    break;
+  case KeyRelease:
+    log_event_begin("key release");
+    handle_key_release((XKeyEvent*)&event->xkey);
+    break;
+  case MotionNotify:
+    log_event_begin("motion notify");
+    handle_motion((XMotionEvent*)&event->xmotion);
+    break;
+  case FocusIn:
+    log_event_begin("focus in");
+    handle_focus_in((XFocusChangeEvent*)&event->xfocus);
+    break;
+  case FocusOut:
+    log_event_begin("focus out");
+    handle_focus_out((XFocusChangeEvent*)&event->xfocus);
+    break;
+  case ConfigureNotify:
+    log_event_begin("configure notify");
+    handle_configure((XConfigureEvent*)&event->xconfigure);
+    break;
+  case ConfigureRequest:
+    log_event_begin("configure request");
+    handle_configure_request((XConfigureRequestEvent*)&event->xconfigurerequest);
+    break;
+  case DestroyNotify:
+    log_event_begin("destroy notify");
+    handle_destroy((XDestroyWindowEvent*)&event->xdestroywindow);
+    break;
+  case ReparentNotify:
+    log_event_begin("reparent notify");
+    handle_reparent((XReparentEvent*)&event->xreparent);
+    break;
+  case PropertyNotify:
+    log_event_begin("property notify");
+    handle_property((XPropertyEvent*)&event->xproperty);
+    break;
+  case Expose:
+    log_event_begin("expose");
+    handle_expose((XExposeEvent*)&event->xexpose);
+    break;
+  case MappingNotify:
+    log_event_begin("mapping notify");
+    handle_mapping((XMappingEvent*)&event->xmapping);
+    break;
+  }
 
-  int y = height + 10;
-  for (unsigned int i = 0; i < clients.length; i++) {
-    Client *c = cb_get(&clients, i);
-    char *str;
-    if (c->name) {
-      str = c->name;
-    } else {
-      str = "???\0";
-    }
-    XDrawString(dsp, switcher_window, gc, 0, y, str, strlen(str));
-    y += height;
+  if (event->type < LASTEvent) {
+    hist_record(&event_latency[event->type], now_ns() - t0);
   }
 }
 
-// grab and dispatch all events in the queue
+// grab and dispatch all events in the queue. unlike XPending, checking
+// with QueuedAfterReading doesn't flush, so requests made by the handlers
+// go out together when the main loop flushes after the drain.
 void handle_xevents() {
-  while (XPending(dsp)) {
+  unsigned int drained = 0;
+  while (XEventsQueued(dsp, QueuedAfterReading)) {
     XEvent event;
     XNextEvent(dsp, &event);
 
-    switch (event.type) {
-    case MapRequest:
-      log_event_begin("map request");
-      handle_map_request((XMapRequestEvent*)&event.xmaprequest);
-      break;
-    case UnmapNotify:
-      log_event_begin("unmap notify");
-      handle_unmap_notify((XUnmapEvent*)&event.xunmap);
-      break;
-    case EnterNotify:
-      log_event_begin("enter notify");
-      handle_enter_notify((XCrossingEvent*)&event.xcrossing);
-      break;
-    case ButtonPress:
-      log_event_begin("button press");
-      handle_button_press((XButtonEvent*)&event.xbutton);
-      break;
-    case ButtonRelease:
-      log_event_begin("button release");
-      handle_button_release((XButtonEvent*)&event.xbutton);
-      break;
-    case KeyPress:
-      log_event_begin("key press");
-      handle_key_press((XKeyEvent*)&event.xkey);
-      break;
-    case KeyRelease:
-      log_event_begin("key release");
-      handle_key_release((XKeyEvent*)&event.xkey);
-      break;
-    case MotionNotify:
-      log_event_begin("motion notify");
+    if (event.type == MotionNotify) {
       // read off all available motion events and use most recent only
       while (XCheckTypedEvent(dsp, MotionNotify, &event));
-      handle_motion((XMotionEvent*)&event.xmotion);
-      break;
-    case FocusIn:
-      log_event_begin("focus in");
-      handle_focus_in((XFocusChangeEvent*)&event.xfocus);
-      break;
-    case FocusOut:
-      log_event_begin("focus out");
-      handle_focus_out((XFocusChangeEvent*)&event.xfocus);
-      break;
-    case ConfigureNotify:
-      log_event_begin("configure notify");
-      handle_configure((XConfigureEvent*)&event.xconfigure);
-      break;
-    case ConfigureRequest:
-      log_event_begin("configure request");
-      handle_configure_request((XConfigureRequestEvent*)&event.xconfigurerequest);
-      break;
-    case DestroyNotify:
-      log_event_begin("destroy notify");
-      handle_destroy((XDestroyWindowEvent*)&event.xdestroywindow);
-      break;
-    case ReparentNotify:
-      log_event_begin("reparent notify");
-      handle_reparent((XReparentEvent*)&event.xreparent);
-      break;
-    case PropertyNotify:
-      log_event_begin("property notify");
-      handle_property((XPropertyEvent*)&event.xproperty);
-      break;
-    case Expose:
-      log_event_begin("expose");
-      handle_expose((XExposeEvent*)&event.xexpose);
-      break;
+    }
+
+    hist_record(&queue_depth, XQLength(dsp));
+    if (trace_recording()) {
+      trace_record(now_ns(), &event);
+    }
+    dispatch_event(&event);
+    drained++;
+  }
+
+  if (drained) {
+    hist_record(&drain_size, drained);
+    trace_flush();
+    if (switcher_is_open()) {
+      refresh_names();
+      switcher_update(transient_switching ? transient_switching_index : 0);
+    }
+  }
+}
+
+// feed every event in a trace through the handlers as fast as possible,
+// then report how long it took.
+void replay(const char *path) {
+  unsigned long count;
+  const TraceRecord *records = trace_map(path, &count);
+  if (!records) {
+    FATAL("could not read trace %s", path);
+  }
+
+  // the handlers send real requests (moves, unmaps, even destroys) to the
+  // recorded window ids, which on a display in use could be anybody's
+  Window root_ret, parent_ret;
+  Window *children;
+  unsigned int nchildren;
+  if (!XQueryTree(dsp, root, &root_ret, &parent_ret, &children, &nchildren)) {
+    FATAL("could not query the root window");
+  }
+  if (children) {
+    XFree(children);
+  }
+  if (nchildren) {
+    FATAL("refusing to replay onto a display with %u windows. use an empty "
+          "one, such as a fresh Xvfb.", nchildren);
+  }
+
+  INFO("replaying %lu events from %s", count, path);
+  long long t0 = now_ns();
+  for (unsigned long i = 0; i < count; i++) {
+    // timers go by the recorded clock, so whatever fired between two
+    // events when recording (switch finalizing, key timeouts, drag
+    // frames) fires between them here too
+    timers_simulate(records[i].t_ns / 1000);
+    timers_run();
+
+    XEvent event = records[i].event;
+    // recorded with the recording process's display, which handlers like
+    // XLookupKeysym follow
+    event.xany.display = dsp;
+    dispatch_event(&event);
+    // don't let replies pile up
+    if (i % 1024 == 0) {
+      async_collect();
+      xreq_flush_stacking();
     }
   }
+  // let anything still pending go off
+  if (count) {
+    timers_simulate(records[count - 1].t_ns / 1000 + 60 * 1000000LL);
+    timers_run();
+  }
+  xreq_flush_stacking();
+  XSync(dsp, False);
+  async_collect_all();
+  long long t = now_ns() - t0;
+
+  INFO("replayed %lu events in %.1f ms, %.0f events/s",
+       count, t / 1e6, count / (t / 1e9));
+  log_stats();
+  trace_unmap(records, count);
 }
 
-// set-up and grab the given key
-void setup_grab_key(Key *k) {
-  KeyCode kc = XKeysymToKeycode(dsp, k->sym);
-  k->kc = kc;
-  XGrabKey(dsp, kc, k->mods, root, False, GrabModeAsync, GrabModeAsync);
+// Start managing the windows which were already there when we started.
+// All queries are sent before any reply is waited on, so this costs about
+// one round trip however many windows there are.
+void adopt_existing_windows() {
+  long long t0 = timers_now_us();
+
+  xcb_query_tree_reply_t *tree =
+    xcb_query_tree_reply(xcb, xcb_query_tree(xcb, root), NULL);
+  if (!tree) {
+    FATAL("couldn't query initial window list");
+  }
+  int count = xcb_query_tree_children_length(tree);
+  xcb_window_t *children = xcb_query_tree_children(tree);
+
+  xcb_get_window_attributes_cookie_t *attr_cks =
+    malloc(sizeof(*attr_cks) * (count ? count : 1));
+  xcb_get_geometry_cookie_t *geom_cks =
+    malloc(sizeof(*geom_cks) * (count ? count : 1));
+  xcb_get_property_cookie_t *state_cks =
+    malloc(sizeof(*state_cks) * (count ? count : 1));
+  for (int i = 0; i < count; i++) {
+    attr_cks[i] = xcb_get_window_attributes(xcb, children[i]);
+    geom_cks[i] = xcb_get_geometry(xcb, children[i]);
+    state_cks[i] = xcb_get_property(xcb, 0, children[i], wm_state, wm_state,
+                                    0, 2);
+  }
+
+  int adopted = 0;
+  for (int i = 0; i < count; i++) {
+    Window win = children[i];
+    xcb_get_window_attributes_reply_t *attr =
+      xcb_get_window_attributes_reply(xcb, attr_cks[i], NULL);
+    xcb_get_geometry_reply_t *geom =
+      xcb_get_geometry_reply(xcb, geom_cks[i], NULL);
+    xcb_get_property_reply_t *state =
+      xcb_get_property_reply(xcb, state_cks[i], NULL);
+    char iconic = state && state->format == 32 &&
+      xcb_get_property_value_length(state) >= 4 &&
+      *(uint32_t*)xcb_get_property_value(state) == IconicState;
+
+    if (!attr || !geom) {
+      WARN("failed to get window attributes for %x", win);
+    } else if (attr->override_redirect) {
+      INFO("ignoring override_redirect window %x", win);
+    } else if (attr->_class == XCB_WINDOW_CLASS_INPUT_ONLY) {
+      INFO("ignoring input-only window %x", win);
+    } else if (attr->map_state != XCB_MAP_STATE_VIEWABLE && !iconic) {
+      // if it's mapped later we'll get a map request for it
+      INFO("ignoring unmapped window %x", win);
+    } else {
+      Rectangle bounds = { geom->x, geom->y, geom->width, geom->height };
+      manage_new_window(win, &bounds);
+      if (attr->map_state != XCB_MAP_STATE_VIEWABLE) {
+        // hidden on another workspace, probably by an earlier run of ours.
+        // there's no telling which, so bring it here.
+        INFO("mapping iconic window %x", win);
+        XMapWindow(dsp, win);
+      }
+      adopted++;
+    }
+    free(attr);
+    free(geom);
+    free(state);
+  }
+
+  free(attr_cks);
+  free(geom_cks);
+  free(state_cks);
+  free(tree);
+
+  INFO("adopted %d of %d windows in %lld us",
+       adopted, count, timers_now_us() - t0);
 }
 
 int main(int argc, char** argv) {
-  struct sigaction act;
-  act.sa_handler = timer_handler;
-  sigemptyset(&act.sa_mask);
-  act.sa_flags = 0;
-  sigaction(SIGALRM, &act, NULL);
+  // SIGUSR1 dumps stats. it's read from a signalfd, so block it before
+  // any threads start and inherit the default disposition.
+  sigset_t sigs;
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGUSR1);
+  sigprocmask(SIG_BLOCK, &sigs, NULL);
+
+  log_init();
+
+  // --record FILE appends every dispatched event to a trace.
+  // --replay FILE runs a trace through the handlers and exits.
+  // --outline drags outlines instead of windows.
+  const char *record_path = NULL;
+  const char *replay_path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (!strcmp(argv[i], "--outline")) {
+      outline_drags = 1;
+    } else {
+      FATAL("usage: %s [--outline] [--record FILE | --replay FILE]", argv[0]);
+    }
+  }
+
+  if (record_path && !trace_open(record_path)) {
+    FATAL("could not open trace %s", record_path);
+  }
 
   dsp = XOpenDisplay(NULL);
   if (!dsp) {
@@ -1037,10 +1722,18 @@ int main(int argc, char** argv) {
 
   XSetErrorHandler(error_handler);
 
+  async_init(dsp);
+  xreq_init(dsp);
+
+  net_wm_name = XInternAtom(dsp, "_NET_WM_NAME", False);
+  utf8_string = XInternAtom(dsp, "UTF8_STRING", False);
+  wm_state = XInternAtom(dsp, "WM_STATE", False);
+
   root = XDefaultRootWindow(dsp);
   if (!root) {
     FATAL("could not open display");
   }
+  switcher_init(dsp, root);
 
   int default_screen = DefaultScreen(dsp);
 
@@ -1082,20 +1775,33 @@ int main(int argc, char** argv) {
   }
   switching_colour = col;
 
-  cb_init(&clients, 500);
-  wb_init(&window_focus_history, 500);
-
-  Window retroot, retparent;
-  Window* children;
-  unsigned int count;
-  st = XQueryTree(dsp, root, &retroot, &retparent, &children, &count);
-  if (!st) {
-    FATAL("couldn't query initial window list");
-  }
-  for (unsigned int i = 0; i < count; i++) {
-    manage_new_window(children[i]);
+  // xor'ing with this turns black to white and back, and everything else
+  // to something else visible
+  XGCValues gcv;
+  gcv.function = GXxor;
+  gcv.foreground = BlackPixel(dsp, default_screen) ^
+    WhitePixel(dsp, default_screen);
+  gcv.subwindow_mode = IncludeInferiors;
+  outline_gc = XCreateGC(dsp, root,
+                         GCFunction | GCForeground | GCSubwindowMode, &gcv);
+
+  clients_init(16);
+  snap_init();
+
+  switch_timer.fn = finalize_window_switching;
+  drag_timer.fn = drag_frame_due;
+  keys_init(grab_keyboard, KEY_SEQ_TIMEOUT_MS * 1000LL, KEY_HOLD_MS * 1000LL);
+
+  if (replay_path) {
+    replaying = 1;
+    timers_init();
+    build_keys();
+    replay(replay_path);
+    log_sync();
+    return 0;
   }
-  XFree(children);
+
+  adopt_existing_windows();
 
   drag_state.win = 0;
 
@@ -1103,33 +1809,63 @@ int main(int argc, char** argv) {
               ButtonPressMask | ButtonReleaseMask | Button1MotionMask,
               GrabModeAsync, GrabModeAsync, None, None);
 
-  for (unsigned int i = 0; i < sizeof(keys) / sizeof(Key); i++) {
-    setup_grab_key(&keys[i]);
-  }
-
-  setup_grab_key(&kmodr);
-  setup_grab_key(&kmodl);
+  setup_keys();
 
   XSelectInput(dsp, root, SubstructureRedirectMask | SubstructureNotifyMask);
 
   int xfd = ConnectionNumber(dsp);
+  int tfd = timers_init();
+  if (tfd < 0) {
+    FATAL("could not create timerfd");
+  }
 
-  for (;;) {
-    if (timer_expired) {
-      timer_expired = 0;
-      finalize_window_switching();
-    }
+  int efd = epoll_create1(EPOLL_CLOEXEC);
+  if (efd < 0) {
+    FATAL("could not create epoll instance");
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = xfd;
+  epoll_ctl(efd, EPOLL_CTL_ADD, xfd, &ev);
+  ev.data.fd = tfd;
+  epoll_ctl(efd, EPOLL_CTL_ADD, tfd, &ev);
+
+  int sfd = signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (sfd < 0) {
+    FATAL("could not create signalfd");
+  }
+  ev.data.fd = sfd;
+  epoll_ctl(efd, EPOLL_CTL_ADD, sfd, &ev);
 
+  for (;;) {
     handle_xevents();
+    async_collect();
+    xreq_flush_stacking();
+    XFlush(dsp);
+    xcb_flush(xcb);
+
+    // handle_xevents drains the socket and Xlib's queue, but reading
+    // replies since then (async_collect, refresh_names) may have pulled
+    // more events off the socket into xcb's queue, where they won't make
+    // xfd readable. QueuedAfterReading looks there too, without flushing.
+    if (XEventsQueued(dsp, QueuedAfterReading)) {
+      continue;
+    }
 
-    // todo - what to do about this gap here?
-    // ie: XPending returns nothing, then before we start polling,
-    // X writes a new event.
-
-    // sleep, but not if there's incoming data
-    struct pollfd fds[1];
-    fds[0].fd = xfd;
-    fds[0].events = POLLIN;
-    poll(fds, 1, 100);
+    // block until there's something from the server or a timer is due
+    struct epoll_event ready[3];
+    int n = epoll_wait(efd, ready, 3, -1);
+    if (n < 0 && errno != EINTR) {
+      FATAL("epoll_wait failed");
+    }
+    for (int i = 0; i < n; i++) {
+      if (ready[i].data.fd == tfd) {
+        timers_run();
+      } else if (ready[i].data.fd == sfd) {
+        struct signalfd_siginfo si;
+        while (read(sfd, &si, sizeof(si)) == sizeof(si));
+        log_stats();
+      }
+    }
   }
 }
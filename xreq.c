@@ -0,0 +1,230 @@
+#include "xreq.h"
+#include "clients.h"
+#include "log.h"
+#include <assert.h>
+#include <stdlib.h>
+
+static Display *dsp;
+
+// whether the top of our stacking order is on top on the server too, and
+// not under something we don't manage
+static char top_known = 0;
+
+// Stacking changes waiting for the flush, as raises to the top and lowers
+// to the bottom. Only the last of a window's moves affects where it ends
+// up, so a new move replaces its earlier one, and what's sent is one
+// request per window which moved, in the order of their last moves.
+typedef struct {
+  // None if it has moved again since
+  Window win;
+  char raise;
+} StackOp;
+
+static StackOp *ops = NULL;
+static unsigned int ops_len, ops_cap;
+
+enum {
+  REQ_GEOMETRY, REQ_BORDER_WIDTH, REQ_BORDER_COLOUR, REQ_RAISE, REQ_LOWER,
+  REQ_RESTACK, REQ_KINDS
+};
+
+static const char* kind_names[REQ_KINDS] = {
+  "geometry", "border width", "border colour", "raise", "lower", "restack",
+};
+
+// stacking requests made by xreq_flush_stacking, and the flushes sending
+// them
+static unsigned long stack_requests;
+static unsigned long stack_flushes;
+
+static unsigned long sent[REQ_KINDS];
+static unsigned long suppressed[REQ_KINDS];
+
+void xreq_init(Display *d) {
+  dsp = d;
+  top_known = 0;
+  ops_len = 0;
+}
+
+void xreq_move_resize(Window win, Rectangle r) {
+  Client *c = clients_find(win).data;
+  if (c && c->sent_bounds.x == r.x && c->sent_bounds.y == r.y &&
+      c->sent_bounds.w == r.w && c->sent_bounds.h == r.h) {
+    suppressed[REQ_GEOMETRY]++;
+    return;
+  }
+  sent[REQ_GEOMETRY]++;
+  if (c) {
+    c->sent_serial = NextRequest(dsp);
+    c->sent_bounds = r;
+  }
+  XMoveResizeWindow(dsp, win, r.x, r.y, r.w, r.h);
+}
+
+void xreq_resize(Window win, int w, int h) {
+  Client *c = clients_find(win).data;
+  if (c && c->sent_bounds.w == w && c->sent_bounds.h == h) {
+    suppressed[REQ_GEOMETRY]++;
+    return;
+  }
+  sent[REQ_GEOMETRY]++;
+  if (c) {
+    c->sent_serial = NextRequest(dsp);
+    c->sent_bounds.w = w;
+    c->sent_bounds.h = h;
+  }
+  XResizeWindow(dsp, win, w, h);
+}
+
+void xreq_border_width(Window win, int width) {
+  Client *c = clients_find(win).data;
+  if (c && c->sent_border_width == width) {
+    suppressed[REQ_BORDER_WIDTH]++;
+    return;
+  }
+  sent[REQ_BORDER_WIDTH]++;
+  if (c) {
+    c->sent_serial = NextRequest(dsp);
+    c->sent_border_width = width;
+  }
+  XSetWindowBorderWidth(dsp, win, width);
+}
+
+void xreq_border_colour(Window win, unsigned long pixel) {
+  Client *c = clients_find(win).data;
+  if (c && c->sent_border_colour_known && c->sent_border_colour == pixel) {
+    suppressed[REQ_BORDER_COLOUR]++;
+    return;
+  }
+  sent[REQ_BORDER_COLOUR]++;
+  XSetWindowBorder(dsp, win, pixel);
+  if (c) {
+    c->sent_border_colour = pixel;
+    c->sent_border_colour_known = 1;
+  }
+}
+
+static void record_move(Client *c, Window win, char raise) {
+  if (c->stack_op) {
+    ops[c->stack_op - 1].win = None;
+  }
+  if (ops_len == ops_cap) {
+    ops_cap = ops_cap ? ops_cap * 2 : 16;
+    ops = realloc(ops, sizeof(StackOp) * ops_cap);
+    assert(ops);
+  }
+  ops[ops_len].win = win;
+  ops[ops_len].raise = raise;
+  c->stack_op = ++ops_len;
+}
+
+void xreq_raise(Window win) {
+  Client *c = clients_find(win).data;
+  if (!c) {
+    sent[REQ_RAISE]++;
+    XRaiseWindow(dsp, win);
+    top_known = 0;
+    return;
+  }
+  if (!clients_stack_raise(win) && top_known) {
+    suppressed[REQ_RAISE]++;
+    return;
+  }
+  sent[REQ_RAISE]++;
+  record_move(c, win, 1);
+  top_known = 1;
+}
+
+void xreq_lower(Window win) {
+  Client *c = clients_find(win).data;
+  if (!c) {
+    sent[REQ_LOWER]++;
+    XLowerWindow(dsp, win);
+    return;
+  }
+  if (!clients_stack_lower(win)) {
+    suppressed[REQ_LOWER]++;
+    return;
+  }
+  sent[REQ_LOWER]++;
+  record_move(c, win, 0);
+}
+
+void xreq_restack(Window *wins, unsigned int n) {
+  // raising from the bottom up leaves them in order with wins[0] on top.
+  // only the ones which actually move are sent.
+  for (unsigned int i = n; i-- > 0;) {
+    Client *c = clients_find(wins[i]).data;
+    if (!c) {
+      continue;
+    }
+    if (clients_stack_raise(wins[i])) {
+      sent[REQ_RESTACK]++;
+      record_move(c, wins[i], 1);
+    } else {
+      suppressed[REQ_RESTACK]++;
+    }
+  }
+  if (n && !top_known) {
+    Client *c = clients_find(wins[0]).data;
+    if (c) {
+      record_move(c, wins[0], 1);
+      top_known = 1;
+    }
+  }
+}
+
+void xreq_sync_stacking(Window win) {
+  // new clients go on top of our order
+  Client *c = clients_find(win).data;
+  if (c) {
+    record_move(c, win, 1);
+  }
+}
+
+void xreq_flush_stacking() {
+  if (!ops_len) {
+    return;
+  }
+  stack_flushes++;
+
+  for (unsigned int i = 0; i < ops_len; i++) {
+    Client *c = clients_find(ops[i].win).data;
+    if (!c) {
+      // moved again, or gone
+      continue;
+    }
+    c->stack_op = 0;
+    XWindowChanges changes;
+    changes.stack_mode = ops[i].raise ? Above : Below;
+    XConfigureWindow(dsp, ops[i].win, CWStackMode, &changes);
+    stack_requests++;
+  }
+  ops_len = 0;
+}
+
+void xreq_note_configure(Client *c, XConfigureEvent *event) {
+  // generated before the server got to our latest request, so whatever it
+  // says is about to be replaced by what we asked for
+  if ((long)(event->serial - c->sent_serial) < 0) {
+    return;
+  }
+  c->sent_bounds.x = event->x;
+  c->sent_bounds.y = event->y;
+  c->sent_bounds.w = event->width;
+  c->sent_bounds.h = event->height;
+  c->sent_border_width = event->border_width;
+}
+
+void xreq_note_restacked() {
+  top_known = 0;
+}
+
+void xreq_log_stats() {
+  INFO("%-18s %8s %10s", "requests", "sent", "suppressed");
+  for (unsigned int i = 0; i < REQ_KINDS; i++) {
+    INFO("%-18s %8lu %10lu", kind_names[i], sent[i], suppressed[i]);
+  }
+  INFO("stacking sent as %lu requests in %lu flushes",
+       stack_requests, stack_flushes);
+}
@@ -0,0 +1,55 @@
+#ifndef XREQ_H
+#define XREQ_H
+
+#include "client.h"
+#include <X11/Xlib.h>
+
+// Requests which change a client's window, minus the ones which wouldn't
+// change anything.
+//
+// Each client remembers the geometry, border width and border colour we
+// last asked for. A request matching what's already there is counted and
+// dropped. Windows we don't manage are always sent the request.
+//
+// The cache is corrected from ConfigureNotify, so a client which moves
+// itself doesn't get stuck with a stale entry. Notifies the server sent
+// before processing our latest geometry request are ignored, since they
+// describe a state that request has replaced.
+//
+// Stacking requests for clients only change our own stacking order (see
+// clients_stack_raise) and note the move. xreq_flush_stacking, once per
+// drain, sends one request for each client which moved, so a window
+// raised several times in a drain costs one request, and one already
+// where it's asked to go costs none. The cost of a flush is in the number
+// of moves, not the number of clients.
+
+void xreq_init(Display *dsp);
+
+void xreq_move_resize(Window win, Rectangle r);
+void xreq_resize(Window win, int w, int h);
+void xreq_border_width(Window win, int width);
+void xreq_border_colour(Window win, unsigned long pixel);
+void xreq_raise(Window win);
+void xreq_lower(Window win);
+
+// put wins on top of everything else, in order, first on top
+void xreq_restack(Window *wins, unsigned int n);
+
+// send win's place in our stacking order at the next flush, though we
+// haven't moved it. for new clients, which go on top of our order but
+// may not be on top on the server.
+void xreq_sync_stacking(Window win);
+
+// send the server whatever has changed in our stacking order
+void xreq_flush_stacking();
+
+// record what the server says a client's geometry is, unless it's out of
+// date
+void xreq_note_configure(Client *c, XConfigureEvent *event);
+
+// something we don't manage may have been stacked above our top client
+void xreq_note_restacked();
+
+void xreq_log_stats();
+
+#endif